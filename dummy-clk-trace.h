@@ -0,0 +1,131 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Tracepoints for the dummy clk driver
+ *
+ * Copyright 2020 TOPIC Embedded Products. All rights reserved.
+ *
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM dummy_clk
+
+#if !defined(_DUMMY_CLK_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _DUMMY_CLK_TRACE_H
+
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(dummy_clk_request,
+
+	TP_PROTO(u32 id, unsigned long rate),
+
+	TP_ARGS(id, rate),
+
+	TP_STRUCT__entry(
+		__field(u32, id)
+		__field(unsigned long, rate)
+	),
+
+	TP_fast_assign(
+		__entry->id = id;
+		__entry->rate = rate;
+	),
+
+	TP_printk("clock %u rate %lu", __entry->id, __entry->rate)
+);
+
+DECLARE_EVENT_CLASS(dummy_clk_result,
+
+	TP_PROTO(u32 id, unsigned long rate, unsigned long actual_rate,
+		int err),
+
+	TP_ARGS(id, rate, actual_rate, err),
+
+	TP_STRUCT__entry(
+		__field(u32, id)
+		__field(unsigned long, rate)
+		__field(unsigned long, actual_rate)
+		__field(int, err)
+	),
+
+	TP_fast_assign(
+		__entry->id = id;
+		__entry->rate = rate;
+		__entry->actual_rate = actual_rate;
+		__entry->err = err;
+	),
+
+	TP_printk("clock %u rate %lu actual %lu err %d", __entry->id,
+		__entry->rate, __entry->actual_rate, __entry->err)
+);
+
+DEFINE_EVENT(dummy_clk_request, dummy_clk_set_rate_start,
+	TP_PROTO(u32 id, unsigned long rate),
+	TP_ARGS(id, rate)
+);
+
+DEFINE_EVENT(dummy_clk_result, dummy_clk_set_rate_end,
+	TP_PROTO(u32 id, unsigned long rate, unsigned long actual_rate,
+		int err),
+	TP_ARGS(id, rate, actual_rate, err)
+);
+
+DEFINE_EVENT(dummy_clk_request, dummy_clk_prepare_enable_start,
+	TP_PROTO(u32 id, unsigned long rate),
+	TP_ARGS(id, rate)
+);
+
+DEFINE_EVENT(dummy_clk_result, dummy_clk_prepare_enable_end,
+	TP_PROTO(u32 id, unsigned long rate, unsigned long actual_rate,
+		int err),
+	TP_ARGS(id, rate, actual_rate, err)
+);
+
+DEFINE_EVENT(dummy_clk_request, dummy_clk_disable,
+	TP_PROTO(u32 id, unsigned long rate),
+	TP_ARGS(id, rate)
+);
+
+TRACE_EVENT(dummy_clk_bulk_prepare_enable_start,
+
+	TP_PROTO(u32 n_clocks),
+
+	TP_ARGS(n_clocks),
+
+	TP_STRUCT__entry(
+		__field(u32, n_clocks)
+	),
+
+	TP_fast_assign(
+		__entry->n_clocks = n_clocks;
+	),
+
+	TP_printk("%u clocks", __entry->n_clocks)
+);
+
+TRACE_EVENT(dummy_clk_bulk_prepare_enable_end,
+
+	TP_PROTO(u32 n_clocks, int err),
+
+	TP_ARGS(n_clocks, err),
+
+	TP_STRUCT__entry(
+		__field(u32, n_clocks)
+		__field(int, err)
+	),
+
+	TP_fast_assign(
+		__entry->n_clocks = n_clocks;
+		__entry->err = err;
+	),
+
+	TP_printk("%u clocks err %d", __entry->n_clocks, __entry->err)
+);
+
+#endif /* _DUMMY_CLK_TRACE_H */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE dummy-clk-trace
+#include <trace/define_trace.h>
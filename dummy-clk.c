@@ -13,163 +13,4061 @@
 #include <linux/clk.h>
 #include <linux/of.h>
 #include <linux/of_clk.h>
+#include <linux/clk-provider.h>
+#include <linux/hashtable.h>
+#include <linux/async.h>
+#include <linux/completion.h>
+#include <linux/mutex.h>
+#include <linux/pm_runtime.h>
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/uaccess.h>
+#include <linux/idr.h>
+#include <linux/kref.h>
+#include <linux/rwsem.h>
+#include <linux/sort.h>
+#include <linux/bitmap.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/overflow.h>
+#include <linux/delay.h>
+#include <linux/random.h>
+#include <linux/notifier.h>
+#include <linux/workqueue.h>
+#include <linux/regmap.h>
+#include <linux/io.h>
+#include <linux/math64.h>
+#include <linux/log2.h>
+#include <linux/bsearch.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/kfifo.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <net/genetlink.h>
+
+#include "dummy-clk.h"
+
+#ifdef CONFIG_DUMMY_CLK_TRACING
+#define CREATE_TRACE_POINTS
+#include "dummy-clk-trace.h"
+#else
+#define trace_dummy_clk_set_rate_start(...)		do { } while (0)
+#define trace_dummy_clk_set_rate_end(...)		do { } while (0)
+#define trace_dummy_clk_prepare_enable_start(...)	do { } while (0)
+#define trace_dummy_clk_prepare_enable_end(...)		do { } while (0)
+#define trace_dummy_clk_disable(...)			do { } while (0)
+#define trace_dummy_clk_bulk_prepare_enable_start(...)	do { } while (0)
+#define trace_dummy_clk_bulk_prepare_enable_end(...)	do { } while (0)
+#endif
 
 MODULE_DESCRIPTION("Dummy clock driver");
 MODULE_AUTHOR("TOPIC Embedded Products");
 MODULE_LICENSE("GPL v2");
 
-#define DRIVER_NAME "topic-dummy-clk"
+#define DRIVER_NAME "topic-dummy-clk"
+
+#ifdef CONFIG_DUMMY_CLK_BENCH
+/* Upper limit for the iteration count of a debugfs benchmark run */
+#define DUMMY_CLK_BENCH_MAX_ITERATIONS	100000
+#endif
+
+#ifdef CONFIG_DUMMY_CLK_MONITOR
+/*
+ * Register layout of the optional frequency counter IP:
+ *   CTRL      write a channel mask to start those counters, reads back
+ *             the mask of channels still counting
+ *   GATE      gate time in reference clock cycles
+ *   COUNT(n)  edges of channel n seen during the last gate time
+ */
+#define DUMMY_CLK_MEAS_CTRL		0x00
+#define DUMMY_CLK_MEAS_GATE		0x04
+#define DUMMY_CLK_MEAS_COUNT(n)		(0x10 + 4 * (n))
+#define DUMMY_CLK_MEAS_MAX_CHANNELS	32
+#define DUMMY_CLK_MEAS_DEFAULT_GATE	100000
+#endif
+
+#ifdef CONFIG_DUMMY_CLK_SWEEP
+/*
+ * Number of sweep samples buffered per device, must be a power of 2. The
+ * buffer is only allocated when the first sweep starts.
+ */
+#define DUMMY_CLK_SWEEP_FIFO_SIZE	4096
+#endif
+
+#ifdef CONFIG_DUMMY_CLK_RETRY
+/* Backoff limits for retrying degraded clocks */
+#define DUMMY_CLK_RETRY_MIN_MS		10
+#define DUMMY_CLK_RETRY_MAX_MS		10000
+#endif
+
+/* Default idle time before lazily enabled clocks are gated again */
+#define DUMMY_CLK_DEFAULT_IDLE_TIMEOUT_MS	1000
+
+static bool verbose;
+module_param(verbose, bool, 0644);
+MODULE_PARM_DESC(verbose, "Log every per-clock operation at info level");
+
+/*
+ * Per-clock messages are debug output, so a board with many clocks does
+ * not flood the console. The "verbose" parameter brings them back.
+ */
+#define dummy_clk_dbg(dev, fmt, ...)					\
+	do {								\
+		if (verbose)						\
+			dev_info(dev, fmt, ##__VA_ARGS__);		\
+		else							\
+			dev_dbg(dev, fmt, ##__VA_ARGS__);		\
+	} while (0)
+
+/* Async domain for parallel clock bring-up, each instance joins its own */
+static ASYNC_DOMAIN_EXCLUSIVE(dummy_clk_async_domain);
+
+/* Instance numbers for the /dev/dummy-clk<n> nodes */
+static DEFINE_IDA(dummy_clk_ida);
+
+#ifdef CONFIG_DUMMY_CLK_SWEEP
+/*
+ * Runs the sweep steps of all clocks, unbound so sweeps run concurrently,
+ * and freezable so no step changes a rate during system suspend.
+ */
+static struct workqueue_struct *dummy_clk_sweep_wq;
+#endif
+
+/* Module-wide debugfs directory, one subdirectory per device */
+static struct dentry *dummy_clk_debugfs_root;
+
+struct dummy_clk_data;
+
+/*
+ * Synthetic output clock for provider mode: a gate with a freely
+ * programmable rate that does not touch any hardware.
+ */
+struct dummy_clk_output {
+	struct clk_hw hw;
+	unsigned long rate;
+	bool prepared;
+	bool enabled;
+	/* Injected latencies, to mimic slow PLLs */
+	u32 prepare_delay_us;
+	u32 enable_delay_us;
+	u32 set_rate_delay_us;
+	/* Random extra delay of up to this amount */
+	u32 jitter_us;
+	/* Spin instead of sleeping in prepare and set_rate */
+	bool busy_wait;
+};
+
+#define to_dummy_clk_output(_hw) container_of(_hw, struct dummy_clk_output, hw)
+
+struct dummy_clk_provider {
+	struct clk_hw_onecell_data *onecell;
+	u32 n_outputs;
+	struct dummy_clk_output outputs[];
+};
+
+/*
+ * Module-wide registry of the provider clocks used by all instances, so
+ * that instances sharing a clock coalesce their enables and don't reapply
+ * a rate another instance already programmed.
+ */
+struct dummy_clk_shared {
+	struct hlist_node node;
+	struct clk_hw *hw;
+	/* Number of items referring to this clock */
+	unsigned int users;
+	/* Number of items that have it enabled */
+	unsigned int enable_count;
+	/* Rate last programmed through any instance */
+	unsigned long rate;
+};
+
+#define DUMMY_CLK_REGISTRY_BITS	6
+
+static DEFINE_HASHTABLE(dummy_clk_registry, DUMMY_CLK_REGISTRY_BITS);
+/*
+ * Protects the registry and is held across the hardware operations that
+ * update it. Never taken from clock framework callbacks.
+ */
+static DEFINE_MUTEX(dummy_clk_registry_lock);
+
+#ifdef CONFIG_DUMMY_CLK_BENCH
+enum {
+	DUMMY_CLK_BENCH_ENABLE,
+	DUMMY_CLK_BENCH_DISABLE,
+	DUMMY_CLK_BENCH_SET_RATE,
+	DUMMY_CLK_BENCH_NUM_OPS,
+};
+
+static const char * const dummy_clk_bench_op_names[] = {
+	[DUMMY_CLK_BENCH_ENABLE] = "enable",
+	[DUMMY_CLK_BENCH_DISABLE] = "disable",
+	[DUMMY_CLK_BENCH_SET_RATE] = "set_rate",
+};
+
+/* Outcome of benchmarking one operation on one clock */
+struct dummy_clk_bench_result {
+	u64 ops_per_sec;
+	u64 p50_ns;
+	u64 p99_ns;
+	u64 max_ns;
+};
+#endif
+
+/* Per-clock counters, shown in debugfs */
+struct dummy_clk_stats {
+#ifdef CONFIG_DUMMY_CLK_STATS
+	u64 enable_count;
+	u64 disable_count;
+	u64 failure_count;
+	/* Accumulated time spent enabled, excluding the current period */
+	u64 enabled_ns;
+	ktime_t enabled_since;
+	u64 last_set_rate_ns;
+	u64 max_set_rate_ns;
+#ifdef CONFIG_DUMMY_CLK_MONITOR
+	/* Rates sampled by the drift monitor, 0 until the first sample */
+	unsigned long min_rate;
+	unsigned long max_rate;
+	unsigned long last_rate;
+#endif
+#endif
+#ifdef CONFIG_DUMMY_CLK_MONITOR
+	/* Last sample was outside the drift threshold */
+	bool drifted;
+#endif
+};
+
+#ifdef CONFIG_DUMMY_CLK_SWEEP
+/*
+ * Sweep state of one clock. The hrtimer marks the dwell deadlines and
+ * hands each step to a work item, since clk_set_rate() may sleep.
+ */
+struct dummy_clk_sweep {
+	struct hrtimer timer;
+	struct work_struct work;
+	bool running;
+	u32 rate;
+	u32 stop;
+	s64 step;
+	ktime_t dwell;
+	/* Absolute deadline of the next step */
+	ktime_t next;
+	/* Requested rate before the sweep, restored afterwards */
+	u32 saved_frequency;
+};
+#endif
+
+/* Operating point from "topic,clock-frequency-table" */
+struct dummy_clk_opp {
+	u32 frequency;
+	/* What clk_round_rate() made of it at probe */
+	unsigned long rate;
+};
+
+struct dummy_clk_item {
+	u32 id;
+	/* Entry from "clock-names", NULL when the node has none */
+	const char *clk_name;
+	struct clk *clock;
+	/* Protects the rate, state and everything else below */
+	struct mutex lock;
+	u32 frequency;
+	/* DUMMY_CLK_STATE_*, read locklessly by the status paths */
+	u32 state;
+	/* Was enabled when the system suspended, restore on resume */
+	bool resume_enable;
+	struct dummy_clk_data *data;
+	struct dummy_clk_shared *shared;
+	/* Enable stage, clocks of one stage are brought up concurrently */
+	u32 stage;
+	int async_err;
+	/* Failed to come up, being retried in the background */
+	bool degraded;
+#ifdef CONFIG_DUMMY_CLK_RETRY
+	unsigned int retry_count;
+	struct delayed_work retry_work;
+#endif
+	/* Rate as last reported by the clock framework */
+	unsigned long actual_rate;
+#ifdef CONFIG_DUMMY_CLK_MONITOR
+	/* Frequency counter channel, or -1 when not measured */
+	int meas_channel;
+	/* Rate seen by the frequency counter, 0 until measured */
+	unsigned long measured_rate;
+#endif
+#ifdef CONFIG_DUMMY_CLK_NOTIFIER
+	struct notifier_block rate_nb;
+	struct work_struct reassert_work;
+#endif
+	/* Gate the clock while changing its rate, for glitchy providers */
+	bool gate_retune;
+	/* Time the clock was gated during the last such rate change */
+	u64 gate_gap_ns;
+#ifdef CONFIG_DUMMY_CLK_SWEEP
+	struct dummy_clk_sweep sweep;
+#endif
+	/* Allowed rates sorted by frequency, any rate goes when empty */
+	struct dummy_clk_opp *opps;
+	unsigned int n_opps;
+	struct dummy_clk_stats stats;
+#ifdef CONFIG_DUMMY_CLK_SYSFS
+	/* Per-clock sysfs directory "clk<id>" */
+	char name[16];
+	struct device_attribute attr_id;
+	struct device_attribute attr_rate;
+	struct device_attribute attr_actual_rate;
+	struct device_attribute attr_enabled;
+#ifdef CONFIG_DUMMY_CLK_MONITOR
+	struct device_attribute attr_measured_rate;
+#endif
+	struct device_attribute attr_name;
+	struct device_attribute attr_rates;
+	struct device_attribute attr_gate_retune;
+	struct device_attribute attr_gate_gap_ns;
+	struct device_attribute attr_state;
+	struct attribute *attrs[10];
+	struct attribute_group group;
+#endif
+};
+
+#ifdef CONFIG_DUMMY_CLK_SYSFS
+/* Named set of rates, 0 gates the clock */
+struct dummy_clk_profile {
+	const char *name;
+	u32 *frequencies;
+};
+#endif
+
+struct dummy_clk_data {
+	struct platform_device *pdev;
+	struct clk_bulk_data *bulk;
+	u32 n_clocks;
+	bool parallel_enable;
+	/* Async enables of the current stage still running, plus one */
+	atomic_t async_pending;
+	struct completion async_done;
+	bool lazy_enable;
+	/* Keep going with the clocks that work when some fail to enable */
+	bool allow_degraded;
+	/* Re-apply the requested rate when someone else changes it */
+	bool reassert_rate;
+	/* Deviation from the requested rate that needs no reprogramming */
+	u32 rate_tolerance;
+#ifdef CONFIG_DUMMY_CLK_MONITOR
+	/* Periodic rate sampling of all clocks, disabled when 0 */
+	u32 monitor_interval_ms;
+	u32 drift_threshold;
+	struct delayed_work monitor_work;
+	/* Frequency counter, NULL when the node has no "reg" */
+	struct regmap *meas_regmap;
+	u32 meas_ref_frequency;
+	u32 meas_gate_cycles;
+#endif
+	/*
+	 * Held by operations spanning several clocks, such as transactions,
+	 * while they take the item locks in index order. Anything working on
+	 * a single clock only takes that clock's lock.
+	 */
+	struct mutex lock;
+	/* Character device for rate transactions */
+	struct miscdevice miscdev;
+	/*
+	 * Open files keep the driver data alive past unbind through kref.
+	 * gone is set under fops_lock on unbind, after which file operations
+	 * fail instead of touching the clocks.
+	 */
+	struct kref kref;
+	struct rw_semaphore fops_lock;
+	bool gone;
+	int instance;
+	char miscdev_name[32];
+	struct dentry *debugfs_dir;
+#ifdef CONFIG_DUMMY_CLK_BENCH
+	/* Last benchmark run, n_clocks * DUMMY_CLK_BENCH_NUM_OPS entries */
+	struct dummy_clk_bench_result *bench;
+	u32 bench_iterations;
+#endif
+	/* Status page mirrored to userspace through mmap() */
+	struct dummy_clk_status_header *status;
+	size_t status_size;
+	spinlock_t status_lock;
+	/* Netlink message being assembled, sent when batch_depth drops to 0 */
+	struct sk_buff *event_skb;
+	void *event_hdr;
+	unsigned int event_batch_depth;
+	spinlock_t event_lock;
+#ifdef CONFIG_DUMMY_CLK_SWEEP
+	/*
+	 * Samples of all sweeps, drained through read(). Allocated by the
+	 * first sweep under sweep_read_lock, freed with the driver data.
+	 */
+	DECLARE_KFIFO_PTR(sweep_fifo, struct dummy_clk_sweep_sample);
+	spinlock_t sweep_fifo_lock;
+	struct mutex sweep_read_lock;
+	wait_queue_head_t sweep_wait;
+#endif
+	/* Named clocks sorted by name, for lookups by name */
+	struct dummy_clk_item **by_name;
+	u32 n_named;
+#ifdef CONFIG_DUMMY_CLK_SYSFS
+	/* Operating profiles, current_profile is -1 until one is selected */
+	struct dummy_clk_profile *profiles;
+	int n_profiles;
+	int current_profile;
+#endif
+	/* Synthetic output clocks, NULL unless in provider mode */
+	struct dummy_clk_provider *provider;
+	struct dummy_clk_item clocks[];
+};
+
+/* One step of a rate transaction, with the state needed to undo it */
+struct dummy_clk_txn_step {
+	struct dummy_clk_item *clock_item;
+	const struct dummy_clk_update *update;
+	struct clk *parent;
+	int phase;
+	u32 old_frequency;
+	bool old_enabled;
+};
+
+enum {
+	DUMMY_CLK_TXN_DISABLE,	/* Gate first, frees up parents */
+	DUMMY_CLK_TXN_RETUNE,	/* Reprogram running clocks */
+	DUMMY_CLK_TXN_ENABLE,	/* Enable at the new rate last */
+	DUMMY_CLK_TXN_SKIP,	/* Already in the requested state */
+};
+
+static struct dummy_clk_shared *dummy_clk_shared_get(struct clk *clock)
+{
+	struct clk_hw *hw = __clk_get_hw(clock);
+	struct dummy_clk_shared *shared;
+
+	mutex_lock(&dummy_clk_registry_lock);
+	hash_for_each_possible(dummy_clk_registry, shared, node,
+			(unsigned long)hw) {
+		if (shared->hw == hw) {
+			shared->users++;
+			goto out;
+		}
+	}
+
+	shared = kzalloc(sizeof(*shared), GFP_KERNEL);
+	if (shared) {
+		shared->hw = hw;
+		shared->users = 1;
+		hash_add(dummy_clk_registry, &shared->node, (unsigned long)hw);
+	}
+out:
+	mutex_unlock(&dummy_clk_registry_lock);
+	return shared;
+}
+
+static void dummy_clk_shared_put(struct dummy_clk_shared *shared)
+{
+	mutex_lock(&dummy_clk_registry_lock);
+	if (--shared->users == 0) {
+		hash_del(&shared->node);
+		kfree(shared);
+	}
+	mutex_unlock(&dummy_clk_registry_lock);
+}
+
+static void dummy_clk_shared_put_all(void *arg)
+{
+	struct dummy_clk_data *data = arg;
+	int i;
+
+	for (i = 0; i < data->n_clocks; ++i)
+		if (data->clocks[i].shared)
+			dummy_clk_shared_put(data->clocks[i].shared);
+}
+
+static void dummy_clk_lock_all(struct dummy_clk_data *data)
+{
+	int i;
+
+	mutex_lock(&data->lock);
+	for (i = 0; i < data->n_clocks; ++i)
+		mutex_lock_nest_lock(&data->clocks[i].lock, &data->lock);
+}
+
+static void dummy_clk_unlock_all(struct dummy_clk_data *data)
+{
+	int i;
+
+	for (i = data->n_clocks - 1; i >= 0; --i)
+		mutex_unlock(&data->clocks[i].lock);
+	mutex_unlock(&data->lock);
+}
+
+static bool dummy_clk_is_on(const struct dummy_clk_item *clock_item)
+{
+	return READ_ONCE(clock_item->state) == DUMMY_CLK_STATE_ON;
+}
+
+static void dummy_clk_set_state(struct dummy_clk_item *clock_item, u32 state)
+{
+	WRITE_ONCE(clock_item->state, state);
+}
+
+/*
+ * Mirror the state of one clock into the mmap()ed status page. Writers
+ * serialize on status_lock and bump seq around the update, like a
+ * seqcount, so lockless readers in userspace can detect torn reads.
+ */
+static void dummy_clk_publish(struct dummy_clk_item *clock_item)
+{
+	struct dummy_clk_data *data = clock_item->data;
+	struct dummy_clk_status_header *status = data->status;
+	struct dummy_clk_status_entry *entry;
+#ifdef CONFIG_DUMMY_CLK_STATS
+	struct dummy_clk_stats *stats = &clock_item->stats;
+#endif
+	unsigned long flags;
+
+	if (!status)
+		return;
+
+	entry = (struct dummy_clk_status_entry *)(status + 1) + clock_item->id;
+
+	spin_lock_irqsave(&data->status_lock, flags);
+	WRITE_ONCE(status->seq, status->seq + 1);
+	smp_wmb();
+	entry->id = clock_item->id;
+	entry->enabled = dummy_clk_is_on(clock_item);
+	entry->state = READ_ONCE(clock_item->state);
+	entry->degraded = clock_item->degraded;
+	entry->frequency = clock_item->frequency;
+	entry->actual_rate = READ_ONCE(clock_item->actual_rate);
+#ifdef CONFIG_DUMMY_CLK_MONITOR
+	entry->measured_rate = clock_item->measured_rate;
+#endif
+#ifdef CONFIG_DUMMY_CLK_STATS
+	entry->enable_count = stats->enable_count;
+	entry->disable_count = stats->disable_count;
+	entry->failure_count = stats->failure_count;
+	entry->enabled_ns = stats->enabled_ns;
+	entry->last_set_rate_ns = stats->last_set_rate_ns;
+	entry->max_set_rate_ns = stats->max_set_rate_ns;
+#endif
+	smp_wmb();
+	WRITE_ONCE(status->seq, status->seq + 1);
+	spin_unlock_irqrestore(&data->status_lock, flags);
+}
+
+/* ------------------------------------------------------------------ */
+
+static const struct genl_multicast_group dummy_clk_genl_mcgrps[] = {
+	{ .name = DUMMY_CLK_GENL_MCGRP_NAME, },
+};
+
+static struct genl_family dummy_clk_genl_family = {
+	.name = DUMMY_CLK_GENL_NAME,
+	.version = DUMMY_CLK_GENL_VERSION,
+	.maxattr = DUMMY_CLK_A_MAX,
+	.module = THIS_MODULE,
+	.mcgrps = dummy_clk_genl_mcgrps,
+	.n_mcgrps = ARRAY_SIZE(dummy_clk_genl_mcgrps),
+};
+
+/* Send the pending event message. Called with event_lock held. */
+static void dummy_clk_event_flush(struct dummy_clk_data *data)
+{
+	if (!data->event_skb)
+		return;
+
+	genlmsg_end(data->event_skb, data->event_hdr);
+	genlmsg_multicast(&dummy_clk_genl_family, data->event_skb, 0, 0,
+		GFP_ATOMIC);
+	data->event_skb = NULL;
+}
+
+static int dummy_clk_event_start(struct dummy_clk_data *data)
+{
+	data->event_skb = genlmsg_new(NLMSG_GOODSIZE, GFP_ATOMIC);
+	if (!data->event_skb)
+		return -ENOMEM;
+
+	data->event_hdr = genlmsg_put(data->event_skb, 0, 0,
+		&dummy_clk_genl_family, 0, DUMMY_CLK_CMD_EVENT);
+	if (!data->event_hdr ||
+			nla_put_string(data->event_skb, DUMMY_CLK_A_DEVICE,
+				dev_name(&data->pdev->dev))) {
+		nlmsg_free(data->event_skb);
+		data->event_skb = NULL;
+		return -EMSGSIZE;
+	}
+
+	return 0;
+}
+
+static int dummy_clk_event_put(struct sk_buff *skb, u32 type, u32 id,
+	u64 rate, int err)
+{
+	struct nlattr *nest;
+
+	nest = nla_nest_start(skb, DUMMY_CLK_A_EVENT);
+	if (!nest)
+		return -EMSGSIZE;
+
+	if (nla_put_u32(skb, DUMMY_CLK_A_EVENT_TYPE, type) ||
+			nla_put_u32(skb, DUMMY_CLK_A_EVENT_ID, id) ||
+			nla_put_u64_64bit(skb, DUMMY_CLK_A_EVENT_RATE, rate,
+				DUMMY_CLK_A_EVENT_UNSPEC) ||
+			(err && nla_put_s32(skb, DUMMY_CLK_A_EVENT_ERROR, err))) {
+		nla_nest_cancel(skb, nest);
+		return -EMSGSIZE;
+	}
+
+	nla_nest_end(skb, nest);
+	return 0;
+}
+
+/*
+ * Queue a state change event. Outside of a batch it is sent right away,
+ * inside one it is appended to the pending message. Nothing is built
+ * while nobody listens.
+ */
+static void dummy_clk_event(struct dummy_clk_item *clock_item, u32 type,
+	u64 rate, int err)
+{
+	struct dummy_clk_data *data = clock_item->data;
+	unsigned long flags;
+
+	if (!genl_has_listeners(&dummy_clk_genl_family, &init_net, 0))
+		return;
+
+	spin_lock_irqsave(&data->event_lock, flags);
+	if (!data->event_skb && dummy_clk_event_start(data))
+		goto out;
+
+	if (dummy_clk_event_put(data->event_skb, type, clock_item->id, rate,
+			err)) {
+		/* Message full, send it and start a new one */
+		dummy_clk_event_flush(data);
+		if (dummy_clk_event_start(data) ||
+				dummy_clk_event_put(data->event_skb, type,
+					clock_item->id, rate, err))
+			goto out;
+	}
+
+	if (!data->event_batch_depth)
+		dummy_clk_event_flush(data);
+out:
+	spin_unlock_irqrestore(&data->event_lock, flags);
+}
+
+/* Collect the events of a multi-clock operation into one message */
+static void dummy_clk_event_batch_begin(struct dummy_clk_data *data)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&data->event_lock, flags);
+	data->event_batch_depth++;
+	spin_unlock_irqrestore(&data->event_lock, flags);
+}
+
+static void dummy_clk_event_batch_end(struct dummy_clk_data *data)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&data->event_lock, flags);
+	if (--data->event_batch_depth == 0)
+		dummy_clk_event_flush(data);
+	spin_unlock_irqrestore(&data->event_lock, flags);
+}
+
+/* ------------------------------------------------------------------ */
+
+static int dummy_clk_status_init(struct dummy_clk_data *data)
+{
+	int i;
+
+	spin_lock_init(&data->status_lock);
+
+	data->status_size = PAGE_ALIGN(sizeof(*data->status) +
+		array_size(data->n_clocks,
+			sizeof(struct dummy_clk_status_entry)));
+	/* Freed with the driver data, it may still be mapped after unbind */
+	data->status = vmalloc_user(data->status_size);
+	if (!data->status)
+		return -ENOMEM;
+
+	data->status->n_clocks = data->n_clocks;
+	data->status->entry_size = sizeof(struct dummy_clk_status_entry);
+	for (i = 0; i < data->n_clocks; ++i)
+		dummy_clk_publish(&data->clocks[i]);
+
+	return 0;
+}
+
+static int dummy_clk_opp_cmp(const void *a, const void *b)
+{
+	const struct dummy_clk_opp *oa = a;
+	const struct dummy_clk_opp *ob = b;
+
+	if (oa->frequency != ob->frequency)
+		return oa->frequency < ob->frequency ? -1 : 1;
+	return 0;
+}
+
+static const struct dummy_clk_opp *dummy_clk_opp_find(
+	const struct dummy_clk_item *clock_item, u32 frequency)
+{
+	const struct dummy_clk_opp key = { .frequency = frequency };
+
+	return bsearch(&key, clock_item->opps, clock_item->n_opps,
+		sizeof(*clock_item->opps), dummy_clk_opp_cmp);
+}
+
+/* Reject rates missing from the clock's operating point table */
+static int dummy_clk_opp_check(const struct dummy_clk_item *clock_item,
+	u32 frequency)
+{
+	if (!clock_item->n_opps || dummy_clk_opp_find(clock_item, frequency))
+		return 0;
+
+	return -EINVAL;
+}
+
+/*
+ * Parse "topic,clock-frequency-table", a list of <clock-index frequency>
+ * pairs, and round every entry once so that switching between operating
+ * points never has to ask the provider again. Points the provider cannot
+ * produce are dropped here.
+ */
+static int dummy_clk_opp_init(struct dummy_clk_data *data)
+{
+	struct device *dev = &data->pdev->dev;
+	struct device_node *np = dev->of_node;
+	unsigned int *count;
+	u32 *table;
+	int n;
+	int i;
+	int ret = 0;
+
+	n = of_property_count_u32_elems(np, "topic,clock-frequency-table");
+	if (n <= 0)
+		return 0;
+	if (n % 2) {
+		dev_err(dev, "Malformed topic,clock-frequency-table\n");
+		return -EINVAL;
+	}
+
+	table = kcalloc(n, sizeof(*table), GFP_KERNEL);
+	count = kcalloc(data->n_clocks, sizeof(*count), GFP_KERNEL);
+	if (!table || !count) {
+		ret = -ENOMEM;
+		goto out_free;
+	}
+
+	ret = of_property_read_u32_array(np, "topic,clock-frequency-table",
+		table, n);
+	if (ret)
+		goto out_free;
+
+	for (i = 0; i < n; i += 2) {
+		if (table[i] >= data->n_clocks) {
+			dev_err(dev, "Operating point for unknown clock %u\n",
+				table[i]);
+			ret = -EINVAL;
+			goto out_free;
+		}
+		count[table[i]]++;
+	}
+
+	for (i = 0; i < data->n_clocks; ++i) {
+		if (!count[i])
+			continue;
+		data->clocks[i].opps = devm_kcalloc(dev, count[i],
+			sizeof(*data->clocks[i].opps), GFP_KERNEL);
+		if (!data->clocks[i].opps) {
+			ret = -ENOMEM;
+			goto out_free;
+		}
+	}
+
+	for (i = 0; i < n; i += 2) {
+		struct dummy_clk_item *clock_item = &data->clocks[table[i]];
+		long rounded = clk_round_rate(clock_item->clock, table[i + 1]);
+
+		if (rounded <= 0) {
+			dev_warn(dev, "Clock %u cannot run at %u Hz, ignored\n",
+				clock_item->id, table[i + 1]);
+			continue;
+		}
+		clock_item->opps[clock_item->n_opps].frequency = table[i + 1];
+		clock_item->opps[clock_item->n_opps].rate = rounded;
+		clock_item->n_opps++;
+	}
+
+	for (i = 0; i < data->n_clocks; ++i) {
+		struct dummy_clk_item *clock_item = &data->clocks[i];
+
+		sort(clock_item->opps, clock_item->n_opps,
+			sizeof(*clock_item->opps), dummy_clk_opp_cmp, NULL);
+		if (count[i] && !clock_item->n_opps) {
+			dev_err(dev, "No achievable operating point for clock %u\n",
+				i);
+			ret = -EINVAL;
+			goto out_free;
+		}
+		if (dummy_clk_opp_check(clock_item, clock_item->frequency))
+			dev_warn(dev,
+				"Clock %u starts at %u Hz, not an operating point\n",
+				i, clock_item->frequency);
+	}
+
+out_free:
+	kfree(count);
+	kfree(table);
+	return ret;
+}
+
+/*
+ * True when the clock already runs at the requested frequency, or the
+ * provider would end up at its current rate anyway, so that calling
+ * clk_set_rate() would only cause a needless PLL relock.
+ */
+static bool dummy_clk_rate_matches(struct dummy_clk_data *data,
+	struct dummy_clk_item *clock_item)
+{
+	unsigned long rate = clk_get_rate(clock_item->clock);
+	const struct dummy_clk_opp *opp;
+	long rounded;
+
+	if (abs_diff(rate, (unsigned long)clock_item->frequency) <=
+			data->rate_tolerance)
+		return true;
+
+	opp = dummy_clk_opp_find(clock_item, clock_item->frequency);
+	if (opp)
+		return opp->rate == rate;
+
+	rounded = clk_round_rate(clock_item->clock, clock_item->frequency);
+
+	return rounded > 0 && rounded == rate;
+}
+
+#ifdef CONFIG_DUMMY_CLK_STATS
+static void dummy_clk_stats_enabled(struct dummy_clk_item *clock_item)
+{
+	clock_item->stats.enable_count++;
+	clock_item->stats.enabled_since = ktime_get();
+}
+
+static void dummy_clk_stats_disabled(struct dummy_clk_item *clock_item)
+{
+	struct dummy_clk_stats *stats = &clock_item->stats;
+
+	stats->disable_count++;
+	stats->enabled_ns += ktime_to_ns(ktime_sub(ktime_get(),
+		stats->enabled_since));
+}
+
+static void dummy_clk_stats_failed(struct dummy_clk_item *clock_item)
+{
+	clock_item->stats.failure_count++;
+}
+
+static void dummy_clk_stats_set_rate(struct dummy_clk_item *clock_item,
+	ktime_t start)
+{
+	struct dummy_clk_stats *stats = &clock_item->stats;
+
+	stats->last_set_rate_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	stats->max_set_rate_ns = max(stats->max_set_rate_ns,
+		stats->last_set_rate_ns);
+}
+#else
+static inline void dummy_clk_stats_enabled(struct dummy_clk_item *clock_item)
+{
+}
+
+static inline void dummy_clk_stats_disabled(
+	struct dummy_clk_item *clock_item)
+{
+}
+
+static inline void dummy_clk_stats_failed(struct dummy_clk_item *clock_item)
+{
+}
+
+static inline void dummy_clk_stats_set_rate(
+	struct dummy_clk_item *clock_item, ktime_t start)
+{
+}
+#endif
+
+#ifdef CONFIG_DUMMY_CLK_NOTIFIER
+/* The rate notifier keeps actual_rate up to date */
+static inline void dummy_clk_rate_changed(struct dummy_clk_item *clock_item)
+{
+}
+#else
+/*
+ * Without rate notifiers actual_rate and the rate change events only
+ * follow the driver's own rate changes, changes made by others go
+ * unnoticed.
+ */
+static void dummy_clk_rate_changed(struct dummy_clk_item *clock_item)
+{
+	unsigned long rate = clk_get_rate(clock_item->clock);
+
+	if (rate == READ_ONCE(clock_item->actual_rate))
+		return;
+
+	WRITE_ONCE(clock_item->actual_rate, rate);
+	dummy_clk_event(clock_item, DUMMY_CLK_EVENT_RATE_CHANGE, rate, 0);
+}
+#endif
+
+/*
+ * Change the rate of a running clock with the clock gated, keeping the
+ * gated window as short as possible. Called with the registry lock held.
+ */
+static int dummy_clk_gated_set_rate(struct dummy_clk_item *clock_item)
+{
+	struct dummy_clk_shared *shared = clock_item->shared;
+	ktime_t gated;
+	int err;
+	int ret;
+
+	/* Another instance keeps the clock running, gating would not stick */
+	if (shared->enable_count > 1)
+		return -EBUSY;
+
+	clk_disable_unprepare(clock_item->clock);
+	gated = ktime_get();
+	trace_dummy_clk_disable(clock_item->id, clock_item->frequency);
+	err = clk_set_rate(clock_item->clock, clock_item->frequency);
+	trace_dummy_clk_prepare_enable_start(clock_item->id,
+		clock_item->frequency);
+	ret = clk_prepare_enable(clock_item->clock);
+	WRITE_ONCE(clock_item->gate_gap_ns,
+		ktime_to_ns(ktime_sub(ktime_get(), gated)));
+	trace_dummy_clk_prepare_enable_end(clock_item->id,
+		clock_item->frequency, READ_ONCE(clock_item->actual_rate), ret);
+
+	if (ret < 0) {
+		/* The clock stays off, account for it like a disable */
+		shared->enable_count--;
+		dummy_clk_set_state(clock_item, DUMMY_CLK_STATE_FAILED);
+		dummy_clk_stats_failed(clock_item);
+		dummy_clk_stats_disabled(clock_item);
+		dummy_clk_event(clock_item, DUMMY_CLK_EVENT_FAILURE,
+			clock_item->frequency, ret);
+		return ret;
+	}
+
+	return err;
+}
+
+static int dummy_clk_set_rate(struct dummy_clk_data *data,
+	struct dummy_clk_item *clock_item)
+{
+	struct dummy_clk_shared *shared = clock_item->shared;
+	ktime_t start;
+	int err = 0;
+
+	mutex_lock(&dummy_clk_registry_lock);
+
+	/* Another instance keeps this clock running at the same rate */
+	if (shared->enable_count && shared->rate == clock_item->frequency &&
+			READ_ONCE(clock_item->actual_rate) == shared->rate)
+		goto out;
+
+	if (dummy_clk_rate_matches(data, clock_item)) {
+		shared->rate = clock_item->frequency;
+		goto out;
+	}
+
+	if (shared->enable_count && shared->rate)
+		dev_dbg(&data->pdev->dev,
+			"Clock %u overrides shared rate %lu Hz\n",
+			clock_item->id, shared->rate);
+
+	trace_dummy_clk_set_rate_start(clock_item->id, clock_item->frequency);
+	start = ktime_get();
+	if (dummy_clk_is_on(clock_item) && clock_item->gate_retune)
+		err = dummy_clk_gated_set_rate(clock_item);
+	else
+		err = clk_set_rate(clock_item->clock,
+			clock_item->frequency);
+	dummy_clk_stats_set_rate(clock_item, start);
+	dummy_clk_rate_changed(clock_item);
+	/*
+	 * The cached rate is already up to date here, and unlike
+	 * clk_get_rate() it does not take the prepare lock with tracing off.
+	 */
+	trace_dummy_clk_set_rate_end(clock_item->id, clock_item->frequency,
+		READ_ONCE(clock_item->actual_rate), err);
+	if (err < 0) {
+		dummy_clk_stats_failed(clock_item);
+		dummy_clk_event(clock_item, DUMMY_CLK_EVENT_FAILURE,
+			clock_item->frequency, err);
+		dev_err(&data->pdev->dev,
+			"Failed to set clock frequency of clock %u to %u Hz\n",
+			clock_item->id, clock_item->frequency);
+		shared->rate = 0;
+		goto out;
+	}
+	shared->rate = clock_item->frequency;
+
+out:
+	mutex_unlock(&dummy_clk_registry_lock);
+	dummy_clk_publish(clock_item);
+	return err;
+}
+
+/*
+ * Prepare and enable the hardware clock, without touching its rate. Only
+ * the first item enabling a shared clock actually calls into the clock
+ * framework, later ones just take a count in the registry.
+ */
+static int dummy_clk_prepare_enable(struct dummy_clk_item *clock_item)
+{
+	struct dummy_clk_shared *shared = clock_item->shared;
+	int err = 0;
+
+	mutex_lock(&dummy_clk_registry_lock);
+	if (shared->enable_count == 0) {
+		trace_dummy_clk_prepare_enable_start(clock_item->id,
+			clock_item->frequency);
+		err = clk_prepare_enable(clock_item->clock);
+		trace_dummy_clk_prepare_enable_end(clock_item->id,
+			clock_item->frequency,
+			READ_ONCE(clock_item->actual_rate), err);
+	}
+	if (err == 0)
+		shared->enable_count++;
+	mutex_unlock(&dummy_clk_registry_lock);
+
+	if (err < 0) {
+		dummy_clk_stats_failed(clock_item);
+		dummy_clk_event(clock_item, DUMMY_CLK_EVENT_FAILURE,
+			clock_item->frequency, err);
+	} else {
+		dummy_clk_stats_enabled(clock_item);
+		dummy_clk_event(clock_item, DUMMY_CLK_EVENT_ENABLE,
+			READ_ONCE(clock_item->actual_rate), 0);
+	}
+
+	return err;
+}
+
+static void dummy_clk_disable_unprepare(struct dummy_clk_item *clock_item)
+{
+	struct dummy_clk_shared *shared = clock_item->shared;
+
+	mutex_lock(&dummy_clk_registry_lock);
+	if (--shared->enable_count == 0) {
+		clk_disable_unprepare(clock_item->clock);
+		trace_dummy_clk_disable(clock_item->id, clock_item->frequency);
+	}
+	mutex_unlock(&dummy_clk_registry_lock);
+
+	dummy_clk_stats_disabled(clock_item);
+	dummy_clk_event(clock_item, DUMMY_CLK_EVENT_DISABLE,
+		READ_ONCE(clock_item->actual_rate), 0);
+}
+
+static int dummy_clk_enable(struct dummy_clk_data *data,
+	struct dummy_clk_item *clock_item)
+{
+	int err;
+
+	if (dummy_clk_is_on(clock_item))
+		return 0;
+
+	dummy_clk_set_state(clock_item, DUMMY_CLK_STATE_PREPARING);
+	dummy_clk_publish(clock_item);
+
+	err = dummy_clk_set_rate(data, clock_item);
+	if (err < 0)
+		goto err_failed;
+
+	err = dummy_clk_prepare_enable(clock_item);
+	if (err < 0) {
+		dev_err(&data->pdev->dev, "Failed to enable clock %u\n",
+			clock_item->id);
+		goto err_failed;
+	}
+
+	dummy_clk_dbg(&data->pdev->dev, "Clock %u enabled at %lu Hz\n",
+		clock_item->id, clk_get_rate(clock_item->clock));
+
+	/* Whoever brought the clock up, it is no longer degraded */
+	clock_item->degraded = false;
+	dummy_clk_set_state(clock_item, DUMMY_CLK_STATE_ON);
+	dummy_clk_publish(clock_item);
+
+	return 0;
+
+err_failed:
+	dummy_clk_set_state(clock_item, DUMMY_CLK_STATE_FAILED);
+	dummy_clk_publish(clock_item);
+	return err;
+}
+
+/*
+ * Gate a running clock, or just clear the failed state of a broken one.
+ * Turning a degraded clock off also ends its retries.
+ */
+static void dummy_clk_disable(struct dummy_clk_data *data,
+	struct dummy_clk_item *clock_item)
+{
+	if (clock_item->state == DUMMY_CLK_STATE_OFF)
+		return;
+
+	clock_item->degraded = false;
+
+	if (clock_item->state == DUMMY_CLK_STATE_ON) {
+		dummy_clk_disable_unprepare(clock_item);
+		dummy_clk_dbg(&data->pdev->dev, "Clock %u disabled\n",
+			clock_item->id);
+	}
+
+	dummy_clk_set_state(clock_item, DUMMY_CLK_STATE_OFF);
+	dummy_clk_publish(clock_item);
+}
+
+#ifdef CONFIG_DUMMY_CLK_RETRY
+/*
+ * Retry a degraded clock with exponential backoff until it comes up. The
+ * clocks that did come up are left alone in the meantime. Runs on the
+ * freezable workqueue so no retry hits the hardware mid suspend/resume.
+ */
+static void dummy_clk_retry_work(struct work_struct *work)
+{
+	struct dummy_clk_item *clock_item = container_of(to_delayed_work(work),
+		struct dummy_clk_item, retry_work);
+	struct dummy_clk_data *data = clock_item->data;
+	unsigned int delay_ms;
+	int err;
+
+	mutex_lock(&clock_item->lock);
+	/* Someone else brought the clock up or turned it off meanwhile */
+	if (!clock_item->degraded ||
+			clock_item->state != DUMMY_CLK_STATE_FAILED)
+		goto out;
+
+	err = dummy_clk_enable(data, clock_item);
+	if (err == 0) {
+		dev_info(&data->pdev->dev, "Clock %u recovered after %u retries\n",
+			clock_item->id, clock_item->retry_count + 1);
+		goto out;
+	}
+
+	/* Double the delay each time, the clamped shift cannot overflow */
+	clock_item->retry_count++;
+	delay_ms = min_t(unsigned int, DUMMY_CLK_RETRY_MIN_MS <<
+			min_t(unsigned int, clock_item->retry_count,
+				ilog2(DUMMY_CLK_RETRY_MAX_MS /
+					DUMMY_CLK_RETRY_MIN_MS) + 1),
+		DUMMY_CLK_RETRY_MAX_MS);
+	queue_delayed_work(system_freezable_wq, &clock_item->retry_work,
+		msecs_to_jiffies(delay_ms));
+out:
+	mutex_unlock(&clock_item->lock);
+}
+
+static void dummy_clk_mark_degraded(struct dummy_clk_data *data,
+	struct dummy_clk_item *clock_item)
+{
+	dev_warn(&data->pdev->dev, "Clock %u degraded, retrying\n",
+		clock_item->id);
+	clock_item->degraded = true;
+	clock_item->retry_count = 0;
+	dummy_clk_set_state(clock_item, DUMMY_CLK_STATE_FAILED);
+	dummy_clk_publish(clock_item);
+	queue_delayed_work(system_freezable_wq, &clock_item->retry_work,
+		msecs_to_jiffies(DUMMY_CLK_RETRY_MIN_MS));
+}
+
+static void dummy_clk_retry_cancel_all(void *arg)
+{
+	struct dummy_clk_data *data = arg;
+	int i;
+
+	for (i = 0; i < data->n_clocks; ++i)
+		cancel_delayed_work_sync(&data->clocks[i].retry_work);
+}
+#else
+/* Without retries a degraded clock stays down until rebind */
+static void dummy_clk_mark_degraded(struct dummy_clk_data *data,
+	struct dummy_clk_item *clock_item)
+{
+	dev_warn(&data->pdev->dev, "Clock %u degraded\n", clock_item->id);
+	clock_item->degraded = true;
+	dummy_clk_set_state(clock_item, DUMMY_CLK_STATE_FAILED);
+	dummy_clk_publish(clock_item);
+}
+
+static void dummy_clk_retry_cancel_all(void *arg)
+{
+}
+#endif
+
+/*
+ * Boot handoff: take a reference on every clock that the bootloader left
+ * running at the requested rate, without reprogramming it, so downstream
+ * logic never sees the clock stop or change. The other clocks go through
+ * the normal enable path.
+ */
+static void dummy_clk_adopt_boot_clocks(struct dummy_clk_data *data)
+{
+	u32 n_adopted = 0;
+	int i;
+
+	for (i = 0; i < data->n_clocks; ++i) {
+		struct dummy_clk_item *clock_item = &data->clocks[i];
+
+		mutex_lock(&clock_item->lock);
+		if (__clk_is_enabled(clock_item->clock) &&
+				dummy_clk_rate_matches(data, clock_item) &&
+				dummy_clk_prepare_enable(clock_item) == 0) {
+			dummy_clk_set_state(clock_item, DUMMY_CLK_STATE_ON);
+			dummy_clk_publish(clock_item);
+			dummy_clk_dbg(&data->pdev->dev,
+				"Clock %u adopted at %lu Hz\n",
+				clock_item->id, clk_get_rate(clock_item->clock));
+			n_adopted++;
+		}
+		mutex_unlock(&clock_item->lock);
+	}
+
+	dev_dbg(&data->pdev->dev, "Adopted %u of %u clocks from the bootloader\n",
+		n_adopted, data->n_clocks);
+}
+
+static void dummy_clk_enable_async(void *arg, async_cookie_t cookie)
+{
+	struct dummy_clk_item *clock_item = arg;
+	struct dummy_clk_data *data = clock_item->data;
+
+	mutex_lock(&clock_item->lock);
+	clock_item->async_err = dummy_clk_enable(data, clock_item);
+	mutex_unlock(&clock_item->lock);
+	if (atomic_dec_and_test(&data->async_pending))
+		complete(&data->async_done);
+}
+
+/*
+ * Configure and enable all clocks concurrently, one stage at a time. Each
+ * clock of a stage gets its own async entry, and the stage is joined
+ * before the next one starts, so dependent domains still come up in
+ * order. Without stages all clocks are in stage 0. The join only waits
+ * for this instance's entries, not for those of other instances probing
+ * at the same time.
+ */
+static int dummy_clk_enable_all_parallel(struct dummy_clk_data *data)
+{
+	u32 stage = 0;
+	u32 next_stage;
+	bool more = data->n_clocks > 0;
+	int i;
+	int ret = 0;
+
+	while (more) {
+		more = false;
+		next_stage = U32_MAX;
+		atomic_set(&data->async_pending, 1);
+		reinit_completion(&data->async_done);
+		for (i = 0; i < data->n_clocks; ++i) {
+			struct dummy_clk_item *clock_item = &data->clocks[i];
+
+			if (clock_item->stage == stage) {
+				atomic_inc(&data->async_pending);
+				async_schedule_domain(dummy_clk_enable_async,
+					clock_item, &dummy_clk_async_domain);
+			} else if (clock_item->stage > stage) {
+				next_stage = min(next_stage, clock_item->stage);
+				more = true;
+			}
+		}
+
+		if (!atomic_dec_and_test(&data->async_pending))
+			wait_for_completion(&data->async_done);
+
+		for (i = 0; i < data->n_clocks; ++i) {
+			struct dummy_clk_item *clock_item = &data->clocks[i];
+
+			if (clock_item->stage != stage ||
+					clock_item->async_err == 0)
+				continue;
+
+			dev_err(&data->pdev->dev, "Could not enable clock %u\n",
+				i);
+			if (!ret)
+				ret = clock_item->async_err;
+			if (data->allow_degraded) {
+				mutex_lock(&clock_item->lock);
+				dummy_clk_mark_degraded(data, clock_item);
+				mutex_unlock(&clock_item->lock);
+			}
+		}
+
+		if (ret && !data->allow_degraded)
+			break;
+
+		stage = next_stage;
+	}
+
+	if (data->allow_degraded)
+		return 0;
+
+	/* Don't leave a partially enabled set behind */
+	if (ret) {
+		dummy_clk_lock_all(data);
+		for (i = 0; i < data->n_clocks; ++i)
+			dummy_clk_disable(data, &data->clocks[i]);
+		dummy_clk_unlock_all(data);
+	}
+
+	return ret;
+}
+
+/*
+ * Configure all rates first, then enable every clock in one batched pass
+ * through the bulk API. Clocks that are already running through another
+ * instance, or appear twice in this one, are left out of the batch and
+ * only counted in the registry. Clocks adopted from the bootloader are
+ * left alone entirely. clk_bulk_prepare_enable() unwinds on
+ * failure, so either all clocks end up running or none of them do. Runs
+ * with all clocks locked, the rate notifiers and retries may already be
+ * active.
+ */
+static int dummy_clk_enable_all_serial(struct dummy_clk_data *data)
+{
+	struct clk_bulk_data *batch;
+	int n_batch = 0;
+	int i;
+	int err;
+
+	for (i = 0; i < data->n_clocks; ++i) {
+		if (dummy_clk_is_on(&data->clocks[i]))
+			continue;
+		err = dummy_clk_set_rate(data, &data->clocks[i]);
+		if (err < 0) {
+			if (!data->allow_degraded)
+				return err;
+			data->clocks[i].degraded = true;
+		}
+	}
+
+	batch = kmalloc_array(data->n_clocks, sizeof(*batch), GFP_KERNEL);
+	if (!batch)
+		return -ENOMEM;
+
+	mutex_lock(&dummy_clk_registry_lock);
+	for (i = 0; i < data->n_clocks; ++i)
+		if (!data->clocks[i].degraded &&
+				!dummy_clk_is_on(&data->clocks[i]) &&
+				data->clocks[i].shared->enable_count++ == 0)
+			batch[n_batch++] = data->bulk[i];
+
+	trace_dummy_clk_bulk_prepare_enable_start(n_batch);
+	err = clk_bulk_prepare_enable(n_batch, batch);
+	trace_dummy_clk_bulk_prepare_enable_end(n_batch, err);
+	if (err < 0)
+		for (i = 0; i < data->n_clocks; ++i)
+			if (!data->clocks[i].degraded &&
+					!dummy_clk_is_on(&data->clocks[i]))
+				data->clocks[i].shared->enable_count--;
+	mutex_unlock(&dummy_clk_registry_lock);
+
+	kfree(batch);
+
+	if (err < 0) {
+		dev_err(&data->pdev->dev, "Could not enable clocks\n");
+		for (i = 0; i < data->n_clocks; ++i) {
+			if (dummy_clk_is_on(&data->clocks[i]))
+				continue;
+			dummy_clk_stats_failed(&data->clocks[i]);
+			dummy_clk_event(&data->clocks[i],
+				DUMMY_CLK_EVENT_FAILURE,
+				data->clocks[i].frequency, err);
+		}
+		if (!data->allow_degraded)
+			return err;
+
+		/* Find the culprits one by one, keep the others running */
+		for (i = 0; i < data->n_clocks; ++i)
+			if (!data->clocks[i].degraded &&
+					dummy_clk_enable(data, &data->clocks[i]))
+				data->clocks[i].degraded = true;
+	} else {
+		for (i = 0; i < data->n_clocks; ++i) {
+			if (data->clocks[i].degraded ||
+					dummy_clk_is_on(&data->clocks[i]))
+				continue;
+			dummy_clk_set_state(&data->clocks[i],
+				DUMMY_CLK_STATE_ON);
+			dummy_clk_stats_enabled(&data->clocks[i]);
+			dummy_clk_publish(&data->clocks[i]);
+			dummy_clk_event(&data->clocks[i],
+				DUMMY_CLK_EVENT_ENABLE,
+				READ_ONCE(data->clocks[i].actual_rate), 0);
+			dummy_clk_dbg(&data->pdev->dev,
+				"Clock %u enabled at %lu Hz\n",
+				i, clk_get_rate(data->clocks[i].clock));
+		}
+	}
+
+	for (i = 0; i < data->n_clocks; ++i)
+		if (data->clocks[i].degraded)
+			dummy_clk_mark_degraded(data, &data->clocks[i]);
+
+	return 0;
+}
+
+#ifdef CONFIG_DUMMY_CLK_NOTIFIER
+/*
+ * Track rate changes made by anyone, including parent changes by other
+ * drivers, so actual_rate never goes stale. This runs with the clock
+ * framework's prepare lock held, possibly from within our own
+ * clk_set_rate(), so it must not take the registry lock or any driver
+ * mutex.
+ */
+static int dummy_clk_rate_notify(struct notifier_block *nb,
+	unsigned long event, void *ptr)
+{
+	struct dummy_clk_item *clock_item =
+		container_of(nb, struct dummy_clk_item, rate_nb);
+	struct clk_notifier_data *ndata = ptr;
+	struct dummy_clk_data *data = clock_item->data;
+
+	if (event != POST_RATE_CHANGE)
+		return NOTIFY_DONE;
+
+	WRITE_ONCE(clock_item->actual_rate, ndata->new_rate);
+	dummy_clk_publish(clock_item);
+	dummy_clk_event(clock_item, DUMMY_CLK_EVENT_RATE_CHANGE,
+		ndata->new_rate, 0);
+
+	if (data->reassert_rate && dummy_clk_is_on(clock_item) &&
+			abs_diff(ndata->new_rate,
+				(unsigned long)clock_item->frequency) >
+			data->rate_tolerance)
+		schedule_work(&clock_item->reassert_work);
+
+	return NOTIFY_OK;
+}
+
+static void dummy_clk_reassert_work(struct work_struct *work)
+{
+	struct dummy_clk_item *clock_item =
+		container_of(work, struct dummy_clk_item, reassert_work);
+	struct dummy_clk_data *data = clock_item->data;
+
+	mutex_lock(&clock_item->lock);
+	if (dummy_clk_is_on(clock_item)) {
+		dev_dbg(&data->pdev->dev,
+			"Clock %u moved to %lu Hz, restoring %u Hz\n",
+			clock_item->id, READ_ONCE(clock_item->actual_rate),
+			clock_item->frequency);
+		dummy_clk_set_rate(data, clock_item);
+	}
+	mutex_unlock(&clock_item->lock);
+}
+
+static void dummy_clk_notifiers_unregister(void *arg)
+{
+	struct dummy_clk_data *data = arg;
+	int i;
+
+	for (i = 0; i < data->n_clocks; ++i) {
+		struct dummy_clk_item *clock_item = &data->clocks[i];
+
+		if (clock_item->rate_nb.notifier_call)
+			clk_notifier_unregister(clock_item->clock,
+				&clock_item->rate_nb);
+		cancel_work_sync(&clock_item->reassert_work);
+	}
+}
+
+static int dummy_clk_notifiers_register(struct dummy_clk_data *data)
+{
+	int i;
+	int ret;
+
+	for (i = 0; i < data->n_clocks; ++i)
+		INIT_WORK(&data->clocks[i].reassert_work,
+			dummy_clk_reassert_work);
+
+	ret = devm_add_action_or_reset(&data->pdev->dev,
+		dummy_clk_notifiers_unregister, data);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < data->n_clocks; ++i) {
+		struct dummy_clk_item *clock_item = &data->clocks[i];
+
+		clock_item->actual_rate = clk_get_rate(clock_item->clock);
+		dummy_clk_publish(clock_item);
+		clock_item->rate_nb.notifier_call = dummy_clk_rate_notify;
+		ret = clk_notifier_register(clock_item->clock,
+			&clock_item->rate_nb);
+		if (ret) {
+			clock_item->rate_nb.notifier_call = NULL;
+			dev_err(&data->pdev->dev,
+				"Could not register rate notifier for clock %u\n",
+				i);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+#else
+static int dummy_clk_notifiers_register(struct dummy_clk_data *data)
+{
+	int i;
+
+	if (data->reassert_rate)
+		dev_warn(&data->pdev->dev,
+			"Built without rate notifiers, ignoring topic,reassert-rate\n");
+
+	for (i = 0; i < data->n_clocks; ++i) {
+		struct dummy_clk_item *clock_item = &data->clocks[i];
+
+		clock_item->actual_rate = clk_get_rate(clock_item->clock);
+		dummy_clk_publish(clock_item);
+	}
+
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_DUMMY_CLK_MONITOR
+#ifdef CONFIG_DUMMY_CLK_STATS
+static void dummy_clk_stats_sample(struct dummy_clk_item *clock_item,
+	unsigned long rate)
+{
+	struct dummy_clk_stats *stats = &clock_item->stats;
+
+	if (!stats->last_rate) {
+		stats->min_rate = rate;
+		stats->max_rate = rate;
+	}
+	stats->min_rate = min(stats->min_rate, rate);
+	stats->max_rate = max(stats->max_rate, rate);
+	stats->last_rate = rate;
+}
+#else
+static inline void dummy_clk_stats_sample(struct dummy_clk_item *clock_item,
+	unsigned long rate)
+{
+}
+#endif
+
+/* Tell userspace a clock has left or returned to its requested rate */
+static void dummy_clk_monitor_notify(struct dummy_clk_data *data,
+	struct dummy_clk_item *clock_item, unsigned long rate)
+{
+	char id_env[32];
+	char rate_env[40];
+	char drift_env[24];
+	char *envp[] = { id_env, rate_env, drift_env, NULL };
+
+	snprintf(id_env, sizeof(id_env), "DUMMY_CLK_ID=%u", clock_item->id);
+	snprintf(rate_env, sizeof(rate_env), "DUMMY_CLK_RATE=%lu", rate);
+	snprintf(drift_env, sizeof(drift_env), "DUMMY_CLK_DRIFT=%d",
+		clock_item->stats.drifted);
+
+	kobject_uevent_env(&data->pdev->dev.kobj, KOBJ_CHANGE, envp);
+}
+
+/*
+ * Sample the rate of every enabled clock from a single delayed work, and
+ * only raise an event when a clock crosses the drift threshold.
+ */
+static void dummy_clk_monitor_work(struct work_struct *work)
+{
+	struct dummy_clk_data *data = container_of(to_delayed_work(work),
+		struct dummy_clk_data, monitor_work);
+	int i;
+
+	for (i = 0; i < data->n_clocks; ++i) {
+		struct dummy_clk_item *clock_item = &data->clocks[i];
+		struct dummy_clk_stats *stats = &clock_item->stats;
+		unsigned long rate;
+		bool drifted;
+
+		mutex_lock(&clock_item->lock);
+		if (!dummy_clk_is_on(clock_item)) {
+			mutex_unlock(&clock_item->lock);
+			continue;
+		}
+
+		rate = clk_get_rate(clock_item->clock);
+		dummy_clk_stats_sample(clock_item, rate);
+
+		drifted = abs_diff(rate, (unsigned long)clock_item->frequency) >
+			data->drift_threshold;
+		if (drifted != stats->drifted) {
+			stats->drifted = drifted;
+			dummy_clk_monitor_notify(data, clock_item, rate);
+		}
+		mutex_unlock(&clock_item->lock);
+	}
+
+	queue_delayed_work(system_freezable_wq, &data->monitor_work,
+		msecs_to_jiffies(data->monitor_interval_ms));
+}
+
+static void dummy_clk_monitor_stop(void *arg)
+{
+	struct dummy_clk_data *data = arg;
+
+	cancel_delayed_work_sync(&data->monitor_work);
+}
+
+static int dummy_clk_monitor_start(struct dummy_clk_data *data)
+{
+	struct device_node *np = data->pdev->dev.of_node;
+	int ret;
+
+	of_property_read_u32(np, "topic,monitor-interval-ms",
+		&data->monitor_interval_ms);
+	of_property_read_u32(np, "topic,drift-threshold-hz",
+		&data->drift_threshold);
+	if (!data->monitor_interval_ms)
+		return 0;
+
+	INIT_DELAYED_WORK(&data->monitor_work, dummy_clk_monitor_work);
+	ret = devm_add_action_or_reset(&data->pdev->dev, dummy_clk_monitor_stop,
+		data);
+	if (ret)
+		return ret;
+
+	queue_delayed_work(system_freezable_wq, &data->monitor_work,
+		msecs_to_jiffies(data->monitor_interval_ms));
+
+	return 0;
+}
+
+static const struct regmap_config dummy_clk_meas_regmap_config = {
+	.reg_bits = 32,
+	.val_bits = 32,
+	.reg_stride = 4,
+	.max_register = DUMMY_CLK_MEAS_COUNT(DUMMY_CLK_MEAS_MAX_CHANNELS - 1),
+};
+
+/*
+ * Set up the optional frequency counter. Each clock maps to the counter
+ * channel with the same index, unless "topic,measure-channels" says
+ * otherwise.
+ */
+static int dummy_clk_meas_init(struct dummy_clk_data *data)
+{
+	struct platform_device *pdev = data->pdev;
+	struct device_node *np = pdev->dev.of_node;
+	void __iomem *base;
+	u32 channel;
+	int i;
+
+	for (i = 0; i < data->n_clocks; ++i)
+		data->clocks[i].meas_channel = -1;
+
+	if (!platform_get_resource(pdev, IORESOURCE_MEM, 0))
+		return 0;
+
+	if (of_property_read_u32(np, "topic,measure-ref-frequency",
+			&data->meas_ref_frequency) ||
+			!data->meas_ref_frequency) {
+		dev_err(&pdev->dev, "Frequency counter needs topic,measure-ref-frequency\n");
+		return -EINVAL;
+	}
+	data->meas_gate_cycles = DUMMY_CLK_MEAS_DEFAULT_GATE;
+	of_property_read_u32(np, "topic,measure-gate-cycles",
+		&data->meas_gate_cycles);
+
+	base = devm_platform_ioremap_resource(pdev, 0);
+	if (IS_ERR(base))
+		return PTR_ERR(base);
+
+	data->meas_regmap = devm_regmap_init_mmio(&pdev->dev, base,
+		&dummy_clk_meas_regmap_config);
+	if (IS_ERR(data->meas_regmap))
+		return PTR_ERR(data->meas_regmap);
+
+	for (i = 0; i < data->n_clocks; ++i) {
+		channel = i;
+		of_property_read_u32_index(np, "topic,measure-channels", i,
+			&channel);
+		if (channel < DUMMY_CLK_MEAS_MAX_CHANNELS)
+			data->clocks[i].meas_channel = channel;
+	}
+
+	return 0;
+}
+
+/*
+ * Measure all enabled clocks at once: start every counter channel with a
+ * single write, wait for one gate time, then collect all counts. Clocks
+ * that are more than the rate tolerance off are reported. Called with
+ * all clocks locked.
+ */
+static int dummy_clk_meas_run(struct dummy_clk_data *data)
+{
+	struct device *dev = &data->pdev->dev;
+	u64 gate_us;
+	u32 mask = 0;
+	u32 busy;
+	u32 count;
+	int i;
+	int err;
+
+	if (!data->meas_regmap)
+		return -ENODEV;
+
+	for (i = 0; i < data->n_clocks; ++i)
+		if (dummy_clk_is_on(&data->clocks[i]) &&
+				data->clocks[i].meas_channel >= 0)
+			mask |= BIT(data->clocks[i].meas_channel);
+	if (!mask)
+		return 0;
+
+	err = regmap_write(data->meas_regmap, DUMMY_CLK_MEAS_GATE,
+		data->meas_gate_cycles);
+	if (err)
+		return err;
+	err = regmap_write(data->meas_regmap, DUMMY_CLK_MEAS_CTRL, mask);
+	if (err)
+		return err;
+
+	gate_us = div_u64((u64)data->meas_gate_cycles * USEC_PER_SEC,
+		data->meas_ref_frequency);
+	err = regmap_read_poll_timeout(data->meas_regmap, DUMMY_CLK_MEAS_CTRL,
+		busy, !(busy & mask), 10, 2 * gate_us + USEC_PER_MSEC);
+	if (err) {
+		dev_err(dev, "Frequency counter timed out\n");
+		return err;
+	}
+
+	for (i = 0; i < data->n_clocks; ++i) {
+		struct dummy_clk_item *clock_item = &data->clocks[i];
+
+		if (!dummy_clk_is_on(clock_item) || clock_item->meas_channel < 0)
+			continue;
+
+		err = regmap_read(data->meas_regmap,
+			DUMMY_CLK_MEAS_COUNT(clock_item->meas_channel), &count);
+		if (err)
+			return err;
+
+		clock_item->measured_rate = mul_u64_u32_div(count,
+			data->meas_ref_frequency, data->meas_gate_cycles);
+		dummy_clk_publish(clock_item);
+		if (abs_diff(clock_item->measured_rate,
+				(unsigned long)clock_item->frequency) >
+				data->rate_tolerance)
+			dev_warn(dev, "Clock %u measured at %lu Hz, expected %u Hz\n",
+				clock_item->id, clock_item->measured_rate,
+				clock_item->frequency);
+	}
+
+	return 0;
+}
+#else
+static int dummy_clk_monitor_start(struct dummy_clk_data *data)
+{
+	if (of_find_property(data->pdev->dev.of_node,
+			"topic,monitor-interval-ms", NULL))
+		dev_warn(&data->pdev->dev,
+			"Built without rate monitoring, ignoring topic,monitor-interval-ms\n");
+
+	return 0;
+}
+
+static int dummy_clk_meas_init(struct dummy_clk_data *data)
+{
+	if (platform_get_resource(data->pdev, IORESOURCE_MEM, 0))
+		dev_warn(&data->pdev->dev,
+			"Built without rate monitoring, ignoring the frequency counter\n");
+
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_DUMMY_CLK_SYSFS
+/*
+ * Enable a clock on behalf of a consumer request. In lazy mode this is the
+ * first use that actually prepares the clock, after which runtime PM gates
+ * all clocks again once the device has been idle for the autosuspend delay.
+ */
+static int dummy_clk_claim(struct dummy_clk_data *data,
+	struct dummy_clk_item *clock_item)
+{
+	struct device *dev = &data->pdev->dev;
+	int err;
+
+	err = pm_runtime_get_sync(dev);
+	if (err < 0) {
+		pm_runtime_put_noidle(dev);
+		return err;
+	}
+
+	mutex_lock(&clock_item->lock);
+	err = dummy_clk_enable(data, clock_item);
+	mutex_unlock(&clock_item->lock);
+
+	pm_runtime_mark_last_busy(dev);
+	pm_runtime_put_autosuspend(dev);
+
+	return err;
+}
+#endif
+
+/* ------------------------------------------------------------------ */
+
+static int dummy_clk_name_cmp(const void *a, const void *b)
+{
+	const struct dummy_clk_item * const *ia = a;
+	const struct dummy_clk_item * const *ib = b;
+
+	return strcmp((*ia)->clk_name, (*ib)->clk_name);
+}
+
+static int dummy_clk_name_key_cmp(const void *key, const void *elt)
+{
+	const struct dummy_clk_item * const *item = elt;
+
+	return strcmp(key, (*item)->clk_name);
+}
+
+/* Build the sorted name table from the "clock-names" entries */
+static int dummy_clk_names_init(struct dummy_clk_data *data)
+{
+	int i;
+
+	data->by_name = devm_kcalloc(&data->pdev->dev, data->n_clocks,
+		sizeof(*data->by_name), GFP_KERNEL);
+	if (!data->by_name)
+		return -ENOMEM;
+
+	for (i = 0; i < data->n_clocks; ++i)
+		if (data->clocks[i].clk_name)
+			data->by_name[data->n_named++] = &data->clocks[i];
+
+	sort(data->by_name, data->n_named, sizeof(*data->by_name),
+		dummy_clk_name_cmp, NULL);
+
+	for (i = 1; i < data->n_named; ++i)
+		if (!strcmp(data->by_name[i - 1]->clk_name,
+				data->by_name[i]->clk_name))
+			dev_warn(&data->pdev->dev, "Duplicate clock name %s\n",
+				data->by_name[i]->clk_name);
+
+	return 0;
+}
+
+static struct dummy_clk_item *dummy_clk_find_by_name(
+	struct dummy_clk_data *data, const char *name)
+{
+	struct dummy_clk_item **found;
+
+	found = bsearch(name, data->by_name, data->n_named,
+		sizeof(*data->by_name), dummy_clk_name_key_cmp);
+
+	return found ? *found : NULL;
+}
+
+#ifdef CONFIG_DUMMY_CLK_SYSFS
+/* Look up a clock given either its index or its name */
+static struct dummy_clk_item *dummy_clk_find(struct dummy_clk_data *data,
+	const char *buf)
+{
+	char name[64];
+	u32 id;
+
+	strscpy(name, buf, sizeof(name));
+	strim(name);
+
+	if (kstrtou32(name, 0, &id) == 0)
+		return id < data->n_clocks ? &data->clocks[id] : NULL;
+
+	return dummy_clk_find_by_name(data, name);
+}
+
+/* ------------------------------------------------------------------ */
+
+static ssize_t claim_store(struct device *dev, struct device_attribute *attr,
+	const char *buf, size_t count)
+{
+	struct dummy_clk_data *data = dev_get_drvdata(dev);
+	struct dummy_clk_item *clock_item;
+	int err;
+
+	clock_item = dummy_clk_find(data, buf);
+	if (!clock_item)
+		return -EINVAL;
+
+	err = dummy_clk_claim(data, clock_item);
+	if (err)
+		return err;
+
+	return count;
+}
+static DEVICE_ATTR_WO(claim);
+
+#ifdef CONFIG_DUMMY_CLK_MONITOR
+/* Writing anything measures all enabled clocks with the frequency counter */
+static ssize_t measure_store(struct device *dev, struct device_attribute *attr,
+	const char *buf, size_t count)
+{
+	struct dummy_clk_data *data = dev_get_drvdata(dev);
+	int err;
+
+	dummy_clk_lock_all(data);
+	err = dummy_clk_meas_run(data);
+	dummy_clk_unlock_all(data);
+
+	return err ? err : count;
+}
+static DEVICE_ATTR_WO(measure);
+#endif
+
+static struct attribute *dummy_clk_attrs[] = {
+	&dev_attr_claim.attr,
+#ifdef CONFIG_DUMMY_CLK_MONITOR
+	&dev_attr_measure.attr,
+#endif
+	NULL,
+};
+
+static const struct attribute_group dummy_clk_group = {
+	.attrs = dummy_clk_attrs,
+};
+
+/* ------------------------------------------------------------------ */
+
+#define to_dummy_clk_item(_attr, _member) \
+	container_of(_attr, struct dummy_clk_item, _member)
+
+static ssize_t dummy_clk_id_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct dummy_clk_item *clock_item = to_dummy_clk_item(attr, attr_id);
+
+	return sysfs_emit(buf, "%u\n", clock_item->id);
+}
+
+static ssize_t dummy_clk_name_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct dummy_clk_item *clock_item = to_dummy_clk_item(attr, attr_name);
+
+	return sysfs_emit(buf, "%s\n",
+		clock_item->clk_name ? clock_item->clk_name : "");
+}
+
+static ssize_t dummy_clk_rate_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct dummy_clk_item *clock_item = to_dummy_clk_item(attr, attr_rate);
+
+	return sysfs_emit(buf, "%u\n", clock_item->frequency);
+}
+
+/*
+ * Change the requested rate. A running clock is reprogrammed right away,
+ * a gated one picks up the new rate the next time it is enabled.
+ */
+static ssize_t dummy_clk_rate_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct dummy_clk_item *clock_item = to_dummy_clk_item(attr, attr_rate);
+	struct dummy_clk_data *data = clock_item->data;
+	u32 frequency;
+	u32 old_frequency;
+	int err = 0;
+
+	err = kstrtou32(buf, 0, &frequency);
+	if (err)
+		return err;
+
+	err = dummy_clk_opp_check(clock_item, frequency);
+	if (err)
+		return err;
+
+	mutex_lock(&clock_item->lock);
+	old_frequency = clock_item->frequency;
+	clock_item->frequency = frequency;
+	if (dummy_clk_is_on(clock_item)) {
+		err = dummy_clk_set_rate(data, clock_item);
+		if (err < 0)
+			clock_item->frequency = old_frequency;
+	}
+	mutex_unlock(&clock_item->lock);
+
+	return err < 0 ? err : count;
+}
+
+/* List the operating points as "<frequency> <rounded rate>" lines */
+static ssize_t dummy_clk_rates_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct dummy_clk_item *clock_item = to_dummy_clk_item(attr, attr_rates);
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < clock_item->n_opps; ++i)
+		len += sysfs_emit_at(buf, len, "%u %lu\n",
+			clock_item->opps[i].frequency, clock_item->opps[i].rate);
+
+	return len;
+}
+
+static ssize_t dummy_clk_actual_rate_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct dummy_clk_item *clock_item =
+		to_dummy_clk_item(attr, attr_actual_rate);
+
+	return sysfs_emit(buf, "%lu\n", READ_ONCE(clock_item->actual_rate));
+}
+
+#ifdef CONFIG_DUMMY_CLK_MONITOR
+static ssize_t dummy_clk_measured_rate_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct dummy_clk_item *clock_item =
+		to_dummy_clk_item(attr, attr_measured_rate);
+
+	return sysfs_emit(buf, "%lu\n", clock_item->measured_rate);
+}
+#endif
+
+static ssize_t dummy_clk_gate_retune_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct dummy_clk_item *clock_item =
+		to_dummy_clk_item(attr, attr_gate_retune);
+
+	return sysfs_emit(buf, "%d\n", clock_item->gate_retune);
+}
+
+static ssize_t dummy_clk_gate_retune_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct dummy_clk_item *clock_item =
+		to_dummy_clk_item(attr, attr_gate_retune);
+	bool gate_retune;
+	int err;
+
+	err = kstrtobool(buf, &gate_retune);
+	if (err)
+		return err;
+
+	mutex_lock(&clock_item->lock);
+	clock_item->gate_retune = gate_retune;
+	mutex_unlock(&clock_item->lock);
+
+	return count;
+}
+
+static ssize_t dummy_clk_gate_gap_ns_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct dummy_clk_item *clock_item =
+		to_dummy_clk_item(attr, attr_gate_gap_ns);
+
+	return sysfs_emit(buf, "%llu\n", READ_ONCE(clock_item->gate_gap_ns));
+}
+
+static const char * const dummy_clk_state_names[] = {
+	[DUMMY_CLK_STATE_OFF] = "off",
+	[DUMMY_CLK_STATE_PREPARING] = "preparing",
+	[DUMMY_CLK_STATE_ON] = "on",
+	[DUMMY_CLK_STATE_FAILED] = "failed",
+};
+
+static ssize_t dummy_clk_state_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct dummy_clk_item *clock_item = to_dummy_clk_item(attr, attr_state);
+
+	return sysfs_emit(buf, "%s\n",
+		dummy_clk_state_names[READ_ONCE(clock_item->state)]);
+}
+
+static ssize_t dummy_clk_enabled_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct dummy_clk_item *clock_item =
+		to_dummy_clk_item(attr, attr_enabled);
+
+	return sysfs_emit(buf, "%d\n", dummy_clk_is_on(clock_item));
+}
+
+static ssize_t dummy_clk_enabled_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct dummy_clk_item *clock_item =
+		to_dummy_clk_item(attr, attr_enabled);
+	struct dummy_clk_data *data = clock_item->data;
+	bool enable;
+	int err;
+
+	err = kstrtobool(buf, &enable);
+	if (err)
+		return err;
+
+	if (enable) {
+		err = dummy_clk_claim(data, clock_item);
+		if (err)
+			return err;
+	} else {
+		mutex_lock(&clock_item->lock);
+		dummy_clk_disable(data, clock_item);
+		mutex_unlock(&clock_item->lock);
+	}
+
+	return count;
+}
+
+static void dummy_clk_init_attr(struct device_attribute *dev_attr,
+	const char *name, umode_t mode,
+	ssize_t (*show)(struct device *, struct device_attribute *, char *),
+	ssize_t (*store)(struct device *, struct device_attribute *,
+		const char *, size_t))
+{
+	sysfs_attr_init(&dev_attr->attr);
+	dev_attr->attr.name = name;
+	dev_attr->attr.mode = mode;
+	dev_attr->show = show;
+	dev_attr->store = store;
+}
+
+/* Create the "clk<id>" attribute directory for one clock */
+static int dummy_clk_item_add_group(struct dummy_clk_data *data,
+	struct dummy_clk_item *clock_item)
+{
+	snprintf(clock_item->name, sizeof(clock_item->name), "clk%u",
+		clock_item->id);
+
+	dummy_clk_init_attr(&clock_item->attr_id, "id", 0444,
+		dummy_clk_id_show, NULL);
+	dummy_clk_init_attr(&clock_item->attr_rate, "rate", 0644,
+		dummy_clk_rate_show, dummy_clk_rate_store);
+	dummy_clk_init_attr(&clock_item->attr_actual_rate, "actual_rate", 0444,
+		dummy_clk_actual_rate_show, NULL);
+	dummy_clk_init_attr(&clock_item->attr_enabled, "enabled", 0644,
+		dummy_clk_enabled_show, dummy_clk_enabled_store);
+	dummy_clk_init_attr(&clock_item->attr_name, "name", 0444,
+		dummy_clk_name_show, NULL);
+	dummy_clk_init_attr(&clock_item->attr_rates, "available_rates", 0444,
+		dummy_clk_rates_show, NULL);
+	dummy_clk_init_attr(&clock_item->attr_gate_retune, "gate_retune", 0644,
+		dummy_clk_gate_retune_show, dummy_clk_gate_retune_store);
+	dummy_clk_init_attr(&clock_item->attr_gate_gap_ns, "gate_gap_ns", 0444,
+		dummy_clk_gate_gap_ns_show, NULL);
+	dummy_clk_init_attr(&clock_item->attr_state, "state", 0444,
+		dummy_clk_state_show, NULL);
+
+#ifdef CONFIG_DUMMY_CLK_MONITOR
+	dummy_clk_init_attr(&clock_item->attr_measured_rate, "measured_rate",
+		0444, dummy_clk_measured_rate_show, NULL);
+#endif
+
+	/* The unused tail of attrs[] stays NULL and terminates the list */
+	clock_item->attrs[0] = &clock_item->attr_id.attr;
+	clock_item->attrs[1] = &clock_item->attr_rate.attr;
+	clock_item->attrs[2] = &clock_item->attr_actual_rate.attr;
+	clock_item->attrs[3] = &clock_item->attr_enabled.attr;
+	clock_item->attrs[4] = &clock_item->attr_name.attr;
+	clock_item->attrs[5] = &clock_item->attr_rates.attr;
+	clock_item->attrs[6] = &clock_item->attr_gate_retune.attr;
+	clock_item->attrs[7] = &clock_item->attr_gate_gap_ns.attr;
+	clock_item->attrs[8] = &clock_item->attr_state.attr;
+#ifdef CONFIG_DUMMY_CLK_MONITOR
+	clock_item->attrs[9] = &clock_item->attr_measured_rate.attr;
+#endif
+
+	clock_item->group.name = clock_item->name;
+	clock_item->group.attrs = clock_item->attrs;
+
+	return device_add_group(&data->pdev->dev, &clock_item->group);
+}
+#endif
+
+/* ------------------------------------------------------------------ */
+
+/*
+ * Order transaction steps by phase, then group clocks sharing a parent so
+ * that each parent is retuned in one run, and lower rates go before higher
+ * ones within a group so a parent never has to serve the union of the old
+ * and new rates.
+ */
+static int dummy_clk_txn_cmp(const void *a, const void *b)
+{
+	const struct dummy_clk_txn_step *sa = a;
+	const struct dummy_clk_txn_step *sb = b;
+
+	if (sa->phase != sb->phase)
+		return sa->phase - sb->phase;
+	if (sa->parent != sb->parent)
+		return sa->parent < sb->parent ? -1 : 1;
+	if (sa->update->frequency != sb->update->frequency)
+		return sa->update->frequency < sb->update->frequency ? -1 : 1;
+	return sa->clock_item->id - sb->clock_item->id;
+}
+
+static int dummy_clk_txn_apply_step(struct dummy_clk_data *data,
+	struct dummy_clk_txn_step *step)
+{
+	struct dummy_clk_item *clock_item = step->clock_item;
+
+	if (step->phase == DUMMY_CLK_TXN_SKIP)
+		return 0;
+
+	if (step->update->frequency)
+		clock_item->frequency = step->update->frequency;
+
+	switch (step->phase) {
+	case DUMMY_CLK_TXN_DISABLE:
+		dummy_clk_disable(data, clock_item);
+		return 0;
+	case DUMMY_CLK_TXN_RETUNE:
+		return dummy_clk_set_rate(data, clock_item);
+	default:
+		return dummy_clk_enable(data, clock_item);
+	}
+}
+
+static void dummy_clk_txn_undo_step(struct dummy_clk_data *data,
+	struct dummy_clk_txn_step *step)
+{
+	struct dummy_clk_item *clock_item = step->clock_item;
+
+	if (step->phase == DUMMY_CLK_TXN_SKIP)
+		return;
+
+	if (!step->old_enabled)
+		dummy_clk_disable(data, clock_item);
+
+	clock_item->frequency = step->old_frequency;
+
+	if (step->old_enabled) {
+		if (dummy_clk_is_on(clock_item))
+			dummy_clk_set_rate(data, clock_item);
+		else
+			dummy_clk_enable(data, clock_item);
+	}
+}
+
+/*
+ * Apply a set of updates in one ordered pass, skipping clocks that are
+ * already in the requested state. On failure, every step that was already
+ * applied is undone in reverse order. All clocks stay locked throughout,
+ * so the pass is atomic with respect to single-clock requests.
+ */
+static int dummy_clk_apply_updates(struct dummy_clk_data *data,
+	const struct dummy_clk_update *updates, u32 n_updates)
+{
+	struct device *dev = &data->pdev->dev;
+	struct dummy_clk_txn_step *steps;
+	unsigned long *seen;
+	int i;
+	int err = 0;
+
+	seen = bitmap_zalloc(data->n_clocks, GFP_KERNEL);
+	steps = kcalloc(n_updates, sizeof(*steps), GFP_KERNEL);
+	if (!seen || !steps) {
+		err = -ENOMEM;
+		goto out_free;
+	}
+
+	for (i = 0; i < n_updates; ++i) {
+		const struct dummy_clk_update *update = &updates[i];
+
+		if (update->id >= data->n_clocks || update->enable > 1 ||
+				update->reserved ||
+				test_and_set_bit(update->id, seen) ||
+				(update->frequency &&
+				 dummy_clk_opp_check(&data->clocks[update->id],
+					update->frequency))) {
+			err = -EINVAL;
+			goto out_free;
+		}
+		steps[i].clock_item = &data->clocks[update->id];
+		steps[i].update = update;
+		steps[i].parent = clk_get_parent(steps[i].clock_item->clock);
+	}
+
+	err = pm_runtime_get_sync(dev);
+	if (err < 0) {
+		pm_runtime_put_noidle(dev);
+		goto out_free;
+	}
+
+	dummy_clk_lock_all(data);
+	dummy_clk_event_batch_begin(data);
+
+	for (i = 0; i < n_updates; ++i) {
+		struct dummy_clk_txn_step *step = &steps[i];
+		u32 frequency = step->update->frequency;
+
+		step->old_frequency = step->clock_item->frequency;
+		step->old_enabled = dummy_clk_is_on(step->clock_item);
+		if (step->update->enable == step->old_enabled &&
+				(!frequency || frequency == step->old_frequency))
+			step->phase = DUMMY_CLK_TXN_SKIP;
+		else if (!step->update->enable)
+			step->phase = DUMMY_CLK_TXN_DISABLE;
+		else if (step->old_enabled)
+			step->phase = DUMMY_CLK_TXN_RETUNE;
+		else
+			step->phase = DUMMY_CLK_TXN_ENABLE;
+	}
+	sort(steps, n_updates, sizeof(*steps), dummy_clk_txn_cmp, NULL);
+
+	for (i = 0; i < n_updates; ++i) {
+		err = dummy_clk_txn_apply_step(data, &steps[i]);
+		if (err < 0)
+			break;
+	}
+
+	if (err < 0) {
+		dev_err(dev, "Transaction failed at clock %u, rolling back\n",
+			steps[i].clock_item->id);
+		/* The failed step may have been partially applied */
+		for (; i >= 0; --i)
+			dummy_clk_txn_undo_step(data, &steps[i]);
+	}
+
+	dummy_clk_event_batch_end(data);
+	dummy_clk_unlock_all(data);
+
+	pm_runtime_mark_last_busy(dev);
+	pm_runtime_put_autosuspend(dev);
+
+out_free:
+	kfree(steps);
+	bitmap_free(seen);
+	return err;
+}
+
+/* ------------------------------------------------------------------ */
+
+#ifdef CONFIG_DUMMY_CLK_SYSFS
+/*
+ * Parse "topic,profile-names" and "topic,profile-frequencies", the latter
+ * holding one row of n_clocks rates per profile.
+ */
+static int dummy_clk_profiles_init(struct dummy_clk_data *data)
+{
+	struct device *dev = &data->pdev->dev;
+	struct device_node *np = dev->of_node;
+	u32 *frequencies;
+	int n;
+	int i;
+	int j;
+	int ret;
+
+	data->current_profile = -1;
+
+	n = of_property_count_strings(np, "topic,profile-names");
+	if (n <= 0)
+		return 0;
+
+	if (of_property_count_u32_elems(np, "topic,profile-frequencies") !=
+			n * data->n_clocks) {
+		dev_err(dev, "Need %u topic,profile-frequencies per profile\n",
+			data->n_clocks);
+		return -EINVAL;
+	}
+
+	data->profiles = devm_kcalloc(dev, n, sizeof(*data->profiles),
+		GFP_KERNEL);
+	frequencies = devm_kcalloc(dev, n * data->n_clocks,
+		sizeof(*frequencies), GFP_KERNEL);
+	if (!data->profiles || !frequencies)
+		return -ENOMEM;
+
+	ret = of_property_read_u32_array(np, "topic,profile-frequencies",
+		frequencies, n * data->n_clocks);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < n; ++i) {
+		struct dummy_clk_profile *profile = &data->profiles[i];
+
+		of_property_read_string_index(np, "topic,profile-names", i,
+			&profile->name);
+		profile->frequencies = &frequencies[i * data->n_clocks];
+
+		for (j = 0; j < data->n_clocks; ++j) {
+			if (profile->frequencies[j] &&
+					dummy_clk_opp_check(&data->clocks[j],
+						profile->frequencies[j])) {
+				dev_err(dev,
+					"Profile %s: %u Hz is no operating point of clock %u\n",
+					profile->name, profile->frequencies[j], j);
+				return -EINVAL;
+			}
+		}
+	}
+	data->n_profiles = n;
+
+	return 0;
+}
+
+/*
+ * Switch to a profile. The whole profile goes into one transaction, and
+ * the transaction compares it against the current state with all clocks
+ * locked, so only the clocks whose rate or gating differ are touched and
+ * the deltas cannot go stale before they are applied. Gated clocks keep
+ * their requested rate, so they come back at the same rate.
+ */
+static int dummy_clk_profile_apply(struct dummy_clk_data *data, int index)
+{
+	const struct dummy_clk_profile *profile = &data->profiles[index];
+	struct dummy_clk_update *updates;
+	int i;
+	int err;
+
+	updates = kcalloc(data->n_clocks, sizeof(*updates), GFP_KERNEL);
+	if (!updates)
+		return -ENOMEM;
+
+	for (i = 0; i < data->n_clocks; ++i) {
+		updates[i].id = i;
+		updates[i].frequency = profile->frequencies[i];
+		updates[i].enable = profile->frequencies[i] != 0;
+	}
+
+	err = dummy_clk_apply_updates(data, updates, data->n_clocks);
+	if (!err) {
+		WRITE_ONCE(data->current_profile, index);
+		dev_dbg(&data->pdev->dev, "Profile %s applied\n",
+			profile->name);
+	}
+
+	kfree(updates);
+	return err;
+}
+
+static ssize_t profile_show(struct device *dev, struct device_attribute *attr,
+	char *buf)
+{
+	struct dummy_clk_data *data = dev_get_drvdata(dev);
+	int current_profile = READ_ONCE(data->current_profile);
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < data->n_profiles; ++i)
+		len += sysfs_emit_at(buf, len,
+			i == current_profile ? "%s[%s]" : "%s%s",
+			i ? " " : "", data->profiles[i].name);
+	len += sysfs_emit_at(buf, len, "\n");
+
+	return len;
+}
+
+static ssize_t profile_store(struct device *dev, struct device_attribute *attr,
+	const char *buf, size_t count)
+{
+	struct dummy_clk_data *data = dev_get_drvdata(dev);
+	int i;
+	int err;
+
+	for (i = 0; i < data->n_profiles; ++i)
+		if (sysfs_streq(buf, data->profiles[i].name))
+			break;
+	if (i == data->n_profiles)
+		return -EINVAL;
+
+	err = dummy_clk_profile_apply(data, i);
+
+	return err ? err : count;
+}
+static DEVICE_ATTR_RW(profile);
+
+static struct attribute *dummy_clk_profile_attrs[] = {
+	&dev_attr_profile.attr,
+	NULL,
+};
+
+static const struct attribute_group dummy_clk_profile_group = {
+	.attrs = dummy_clk_profile_attrs,
+};
+
+/*
+ * Remove the device attributes and those of the first n_items clocks.
+ * Removal waits for stores already running, so once this returns nothing
+ * can enable a clock through sysfs any more.
+ */
+static void dummy_clk_sysfs_remove(struct dummy_clk_data *data, int n_items)
+{
+	struct device *dev = &data->pdev->dev;
+	int i;
+
+	for (i = n_items - 1; i >= 0; --i)
+		device_remove_group(dev, &data->clocks[i].group);
+	if (data->n_profiles)
+		device_remove_group(dev, &dummy_clk_profile_group);
+	device_remove_group(dev, &dummy_clk_group);
+}
+
+/*
+ * Not devm managed: the attributes must be gone before remove() disables
+ * the clocks for the last time.
+ */
+static int dummy_clk_sysfs_init(struct dummy_clk_data *data)
+{
+	struct device *dev = &data->pdev->dev;
+	int i;
+	int ret;
+
+	ret = device_add_group(dev, &dummy_clk_group);
+	if (ret) {
+		dev_err(dev, "Could not create sysfs attributes\n");
+		return ret;
+	}
+
+	if (data->n_profiles) {
+		ret = device_add_group(dev, &dummy_clk_profile_group);
+		if (ret) {
+			dev_err(dev, "Could not create profile attribute\n");
+			device_remove_group(dev, &dummy_clk_group);
+			return ret;
+		}
+	}
+
+	for (i = 0; i < data->n_clocks; ++i) {
+		ret = dummy_clk_item_add_group(data, &data->clocks[i]);
+		if (ret) {
+			dev_err(dev,
+				"Could not create sysfs attributes for clock %u\n",
+				i);
+			dummy_clk_sysfs_remove(data, i);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+#else
+/* Profiles are only selected through sysfs, don't bother parsing them */
+static int dummy_clk_profiles_init(struct dummy_clk_data *data)
+{
+	if (of_find_property(data->pdev->dev.of_node, "topic,profile-names",
+			NULL))
+		dev_warn(&data->pdev->dev,
+			"Built without sysfs, ignoring topic,profile-*\n");
+
+	return 0;
+}
+
+static int dummy_clk_sysfs_init(struct dummy_clk_data *data)
+{
+	return 0;
+}
+
+static void dummy_clk_sysfs_remove(struct dummy_clk_data *data, int n_items)
+{
+}
+#endif
+
+/* ------------------------------------------------------------------ */
+
+#ifdef CONFIG_DUMMY_CLK_SWEEP
+static int __init dummy_clk_sweep_wq_create(void)
+{
+	dummy_clk_sweep_wq = alloc_workqueue("dummy-clk-sweep",
+		WQ_UNBOUND | WQ_HIGHPRI | WQ_FREEZABLE, 0);
+
+	return dummy_clk_sweep_wq ? 0 : -ENOMEM;
+}
+
+static void dummy_clk_sweep_wq_destroy(void)
+{
+	destroy_workqueue(dummy_clk_sweep_wq);
+}
+
+static void dummy_clk_sweep_record(struct dummy_clk_item *clock_item,
+	ktime_t timestamp, int err)
+{
+	struct dummy_clk_data *data = clock_item->data;
+	struct dummy_clk_sweep_sample sample = {
+		.timestamp_ns = ktime_to_ns(timestamp),
+		.achieved = clk_get_rate(clock_item->clock),
+		.id = clock_item->id,
+		.requested = clock_item->sweep.rate,
+		.error = err,
+	};
+
+	if (!kfifo_in_spinlocked(&data->sweep_fifo, &sample, 1,
+			&data->sweep_fifo_lock))
+		dev_dbg(&data->pdev->dev, "Sweep buffer full, sample dropped\n");
+
+	wake_up_interruptible(&data->sweep_wait);
+}
+
+/* Drop the runtime PM reference a sweep holds while it runs */
+static void dummy_clk_sweep_put(struct dummy_clk_data *data)
+{
+	pm_runtime_mark_last_busy(&data->pdev->dev);
+	pm_runtime_put_autosuspend(&data->pdev->dev);
+}
+
+/* Apply one sweep step and arm the timer for the next one */
+static void dummy_clk_sweep_work(struct work_struct *work)
+{
+	struct dummy_clk_item *clock_item =
+		container_of(work, struct dummy_clk_item, sweep.work);
+	struct dummy_clk_sweep *sweep = &clock_item->sweep;
+	struct dummy_clk_data *data = clock_item->data;
+	bool done = false;
+	s64 next_rate;
+	int err;
+
+	mutex_lock(&clock_item->lock);
+	if (!sweep->running)
+		goto out;
+
+	/* Turned off meanwhile, there is nothing left to measure */
+	if (!dummy_clk_is_on(clock_item)) {
+		sweep->running = false;
+		clock_item->frequency = sweep->saved_frequency;
+		done = true;
+		goto out;
+	}
+
+	/* Points outside the operating point table are recorded as skipped */
+	err = dummy_clk_opp_check(clock_item, sweep->rate);
+	if (!err) {
+		clock_item->frequency = sweep->rate;
+		err = dummy_clk_set_rate(data, clock_item);
+	}
+	dummy_clk_sweep_record(clock_item, ktime_get(), err);
+
+	next_rate = (s64)sweep->rate + sweep->step;
+	if ((sweep->step > 0 && next_rate > sweep->stop) ||
+			(sweep->step < 0 && next_rate < sweep->stop)) {
+		sweep->running = false;
+		clock_item->frequency = sweep->saved_frequency;
+		dummy_clk_set_rate(data, clock_item);
+		done = true;
+		goto out;
+	}
+
+	sweep->rate = next_rate;
+	sweep->next = ktime_add(sweep->next, sweep->dwell);
+	hrtimer_start(&sweep->timer, sweep->next, HRTIMER_MODE_ABS);
+out:
+	mutex_unlock(&clock_item->lock);
+
+	if (done)
+		dummy_clk_sweep_put(data);
+}
+
+static enum hrtimer_restart dummy_clk_sweep_timer(struct hrtimer *timer)
+{
+	struct dummy_clk_sweep *sweep =
+		container_of(timer, struct dummy_clk_sweep, timer);
+
+	queue_work(dummy_clk_sweep_wq, &sweep->work);
+
+	return HRTIMER_NORESTART;
+}
+
+static int dummy_clk_sweep_start(struct dummy_clk_data *data,
+	const struct dummy_clk_sweep_config *config)
+{
+	struct dummy_clk_item *clock_item;
+	struct dummy_clk_sweep *sweep;
+	int err = 0;
+
+	if (config->id >= data->n_clocks || config->step == 0 ||
+			config->dwell_us == 0 || config->reserved)
+		return -EINVAL;
+
+	mutex_lock(&data->sweep_read_lock);
+	if (!kfifo_initialized(&data->sweep_fifo))
+		err = kfifo_alloc(&data->sweep_fifo, DUMMY_CLK_SWEEP_FIFO_SIZE,
+			GFP_KERNEL);
+	mutex_unlock(&data->sweep_read_lock);
+	if (err)
+		return err;
+
+	clock_item = &data->clocks[config->id];
+	sweep = &clock_item->sweep;
+
+	/* Held until the sweep ends, so autosuspend cannot gate the clock */
+	err = pm_runtime_get_sync(&data->pdev->dev);
+	if (err < 0) {
+		pm_runtime_put_noidle(&data->pdev->dev);
+		return err;
+	}
+	err = 0;
+
+	mutex_lock(&clock_item->lock);
+	if (sweep->running) {
+		err = -EBUSY;
+		goto out;
+	}
+
+	/* Rates of a gated clock would be recorded but never run */
+	if (!dummy_clk_is_on(clock_item)) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	sweep->rate = config->start;
+	sweep->stop = config->stop;
+	sweep->step = config->start <= config->stop ?
+		(s64)config->step : -(s64)config->step;
+	sweep->dwell = us_to_ktime(config->dwell_us);
+	sweep->next = ktime_get();
+	sweep->saved_frequency = clock_item->frequency;
+	sweep->running = true;
+	queue_work(dummy_clk_sweep_wq, &sweep->work);
+out:
+	mutex_unlock(&clock_item->lock);
+	if (err)
+		dummy_clk_sweep_put(data);
+	return err;
+}
+
+static void dummy_clk_sweep_stop(struct dummy_clk_data *data,
+	struct dummy_clk_item *clock_item)
+{
+	struct dummy_clk_sweep *sweep = &clock_item->sweep;
+	bool was_running;
+
+	mutex_lock(&clock_item->lock);
+	was_running = sweep->running;
+	sweep->running = false;
+	mutex_unlock(&clock_item->lock);
+
+	hrtimer_cancel(&sweep->timer);
+	cancel_work_sync(&sweep->work);
+
+	if (!was_running)
+		return;
+
+	mutex_lock(&clock_item->lock);
+	clock_item->frequency = sweep->saved_frequency;
+	dummy_clk_set_rate(data, clock_item);
+	mutex_unlock(&clock_item->lock);
+
+	dummy_clk_sweep_put(data);
+}
+
+static void dummy_clk_sweep_stop_all(void *arg)
+{
+	struct dummy_clk_data *data = arg;
+	int i;
+
+	for (i = 0; i < data->n_clocks; ++i)
+		dummy_clk_sweep_stop(data, &data->clocks[i]);
+}
+
+static int dummy_clk_sweep_init(struct dummy_clk_data *data)
+{
+	int i;
+
+	spin_lock_init(&data->sweep_fifo_lock);
+	mutex_init(&data->sweep_read_lock);
+	init_waitqueue_head(&data->sweep_wait);
+
+	for (i = 0; i < data->n_clocks; ++i) {
+		struct dummy_clk_sweep *sweep = &data->clocks[i].sweep;
+
+		hrtimer_init(&sweep->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+		sweep->timer.function = dummy_clk_sweep_timer;
+		INIT_WORK(&sweep->work, dummy_clk_sweep_work);
+	}
+
+	return devm_add_action_or_reset(&data->pdev->dev,
+		dummy_clk_sweep_stop_all, data);
+}
+
+static ssize_t dummy_clk_read(struct file *file, char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	struct dummy_clk_data *data = container_of(file->private_data,
+		struct dummy_clk_data, miscdev);
+	unsigned int copied;
+	int err;
+
+	if (count < sizeof(struct dummy_clk_sweep_sample))
+		return -EINVAL;
+
+	if (kfifo_is_empty(&data->sweep_fifo)) {
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		err = wait_event_interruptible(data->sweep_wait,
+			!kfifo_is_empty(&data->sweep_fifo) ||
+			READ_ONCE(data->gone));
+		if (err)
+			return err;
+	}
+
+	down_read(&data->fops_lock);
+	if (data->gone) {
+		err = -ENODEV;
+		goto out;
+	}
+
+	mutex_lock(&data->sweep_read_lock);
+	err = kfifo_to_user(&data->sweep_fifo, buf, count, &copied);
+	mutex_unlock(&data->sweep_read_lock);
+out:
+	up_read(&data->fops_lock);
+
+	return err ? err : copied;
+}
+
+static __poll_t dummy_clk_poll(struct file *file, poll_table *wait)
+{
+	struct dummy_clk_data *data = container_of(file->private_data,
+		struct dummy_clk_data, miscdev);
+
+	poll_wait(file, &data->sweep_wait, wait);
+
+	if (READ_ONCE(data->gone))
+		return EPOLLHUP | EPOLLERR;
+
+	return kfifo_is_empty(&data->sweep_fifo) ? 0 : EPOLLIN | EPOLLRDNORM;
+}
+#else
+static inline int dummy_clk_sweep_wq_create(void)
+{
+	return 0;
+}
+
+static inline void dummy_clk_sweep_wq_destroy(void)
+{
+}
+
+static inline int dummy_clk_sweep_init(struct dummy_clk_data *data)
+{
+	return 0;
+}
+
+static inline void dummy_clk_sweep_stop_all(void *arg)
+{
+}
+#endif
+
+/* ------------------------------------------------------------------ */
+
+static long dummy_clk_ioctl_apply(struct dummy_clk_data *data,
+	void __user *argp)
+{
+	struct dummy_clk_transaction txn;
+	struct dummy_clk_update *updates;
+	long ret;
+
+	if (copy_from_user(&txn, argp, sizeof(txn)))
+		return -EFAULT;
+
+	if (txn.reserved || txn.n_updates == 0 ||
+			txn.n_updates > data->n_clocks)
+		return -EINVAL;
+
+	updates = memdup_user(u64_to_user_ptr(txn.updates),
+		array_size(txn.n_updates, sizeof(*updates)));
+	if (IS_ERR(updates))
+		return PTR_ERR(updates);
+
+	ret = dummy_clk_apply_updates(data, updates, txn.n_updates);
+
+	kfree(updates);
+	return ret;
+}
+
+static long dummy_clk_ioctl_lookup(struct dummy_clk_data *data,
+	void __user *argp)
+{
+	struct dummy_clk_lookup lookup;
+	struct dummy_clk_item *clock_item;
+
+	if (copy_from_user(&lookup, argp, sizeof(lookup)))
+		return -EFAULT;
+
+	lookup.name[sizeof(lookup.name) - 1] = '\0';
+	clock_item = dummy_clk_find_by_name(data, lookup.name);
+	if (!clock_item)
+		return -ENOENT;
+
+	lookup.id = clock_item->id;
+	if (copy_to_user(argp, &lookup, sizeof(lookup)))
+		return -EFAULT;
+
+	return 0;
+}
+
+#ifdef CONFIG_DUMMY_CLK_SWEEP
+static long dummy_clk_ioctl_sweep_start(struct dummy_clk_data *data,
+	void __user *argp)
+{
+	struct dummy_clk_sweep_config config;
+
+	if (copy_from_user(&config, argp, sizeof(config)))
+		return -EFAULT;
+
+	return dummy_clk_sweep_start(data, &config);
+}
+
+static long dummy_clk_ioctl_sweep_stop(struct dummy_clk_data *data,
+	void __user *argp)
+{
+	u32 id;
+
+	if (get_user(id, (u32 __user *)argp))
+		return -EFAULT;
+
+	if (id >= data->n_clocks)
+		return -EINVAL;
+
+	dummy_clk_sweep_stop(data, &data->clocks[id]);
+
+	return 0;
+}
+#endif
+
+static long dummy_clk_ioctl(struct file *file, unsigned int cmd,
+	unsigned long arg)
+{
+	struct dummy_clk_data *data = container_of(file->private_data,
+		struct dummy_clk_data, miscdev);
+	long ret;
+
+	down_read(&data->fops_lock);
+	if (data->gone) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	switch (cmd) {
+	case DUMMY_CLK_IOC_APPLY:
+		ret = dummy_clk_ioctl_apply(data, (void __user *)arg);
+		break;
+	case DUMMY_CLK_IOC_LOOKUP:
+		ret = dummy_clk_ioctl_lookup(data, (void __user *)arg);
+		break;
+#ifdef CONFIG_DUMMY_CLK_SWEEP
+	case DUMMY_CLK_IOC_SWEEP_START:
+		ret = dummy_clk_ioctl_sweep_start(data, (void __user *)arg);
+		break;
+	case DUMMY_CLK_IOC_SWEEP_STOP:
+		ret = dummy_clk_ioctl_sweep_stop(data, (void __user *)arg);
+		break;
+#endif
+	default:
+		ret = -ENOTTY;
+		break;
+	}
+out:
+	up_read(&data->fops_lock);
+	return ret;
+}
+
+/* Map the status page read-only, no syscalls are needed to poll it */
+static int dummy_clk_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct dummy_clk_data *data = container_of(file->private_data,
+		struct dummy_clk_data, miscdev);
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	if (vma->vm_pgoff != 0 ||
+			vma->vm_end - vma->vm_start > data->status_size)
+		return -EINVAL;
+
+	/* The status page itself lives as long as the driver data */
+	if (READ_ONCE(data->gone))
+		return -ENODEV;
+
+	vm_flags_clear(vma, VM_MAYWRITE);
+
+	return remap_vmalloc_range(vma, data->status, 0);
+}
+
+static void dummy_clk_data_release(struct kref *kref)
+{
+	struct dummy_clk_data *data =
+		container_of(kref, struct dummy_clk_data, kref);
+
+	vfree(data->status);
+#ifdef CONFIG_DUMMY_CLK_SWEEP
+	kfifo_free(&data->sweep_fifo);
+#endif
+	kfree(data);
+}
+
+/* devm action dropping the reference held by the bound device */
+static void dummy_clk_data_put(void *arg)
+{
+	struct dummy_clk_data *data = arg;
+
+	kref_put(&data->kref, dummy_clk_data_release);
+}
+
+static int dummy_clk_open(struct inode *inode, struct file *file)
+{
+	struct dummy_clk_data *data = container_of(file->private_data,
+		struct dummy_clk_data, miscdev);
+
+	kref_get(&data->kref);
+
+	return 0;
+}
+
+static int dummy_clk_release(struct inode *inode, struct file *file)
+{
+	struct dummy_clk_data *data = container_of(file->private_data,
+		struct dummy_clk_data, miscdev);
+
+	kref_put(&data->kref, dummy_clk_data_release);
+
+	return 0;
+}
+
+static const struct file_operations dummy_clk_fops = {
+	.owner = THIS_MODULE,
+	.open = dummy_clk_open,
+	.release = dummy_clk_release,
+#ifdef CONFIG_DUMMY_CLK_SWEEP
+	.read = dummy_clk_read,
+	.poll = dummy_clk_poll,
+#endif
+	.mmap = dummy_clk_mmap,
+	.unlocked_ioctl = dummy_clk_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+	.llseek = noop_llseek,
+};
+
+static int dummy_clk_miscdev_register(struct dummy_clk_data *data)
+{
+	int ret;
+
+	data->instance = ida_alloc(&dummy_clk_ida, GFP_KERNEL);
+	if (data->instance < 0)
+		return data->instance;
+
+	snprintf(data->miscdev_name, sizeof(data->miscdev_name),
+		"dummy-clk%d", data->instance);
+	data->miscdev.minor = MISC_DYNAMIC_MINOR;
+	data->miscdev.name = data->miscdev_name;
+	data->miscdev.fops = &dummy_clk_fops;
+	data->miscdev.parent = &data->pdev->dev;
+
+	ret = misc_register(&data->miscdev);
+	if (ret) {
+		ida_free(&dummy_clk_ida, data->instance);
+		return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Cut off files that stay open past unbind: operations already running
+ * finish first, later ones fail, and sleeping readers are woken up.
+ */
+static void dummy_clk_miscdev_unregister(struct dummy_clk_data *data)
+{
+	down_write(&data->fops_lock);
+	data->gone = true;
+	up_write(&data->fops_lock);
+#ifdef CONFIG_DUMMY_CLK_SWEEP
+	wake_up_interruptible_all(&data->sweep_wait);
+#endif
+
+	misc_deregister(&data->miscdev);
+	ida_free(&dummy_clk_ida, data->instance);
+}
+
+/* ------------------------------------------------------------------ */
+
+#ifdef CONFIG_DUMMY_CLK_STATS
+static int dummy_clk_stats_show(struct seq_file *s, void *unused)
+{
+	struct dummy_clk_data *data = s->private;
+	int i;
+
+	seq_puts(s, "id  enabled  enables  disables  failures  enabled_ms  last_set_rate_ns  max_set_rate_ns");
+#ifdef CONFIG_DUMMY_CLK_MONITOR
+	seq_puts(s, "  min_rate    max_rate    last_rate");
+#endif
+	seq_putc(s, '\n');
+
+	for (i = 0; i < data->n_clocks; ++i) {
+		struct dummy_clk_item *clock_item = &data->clocks[i];
+		struct dummy_clk_stats *stats = &clock_item->stats;
+		u64 enabled_ns;
+		bool enabled;
+
+		mutex_lock(&clock_item->lock);
+		enabled = dummy_clk_is_on(clock_item);
+		enabled_ns = stats->enabled_ns;
+		if (enabled)
+			enabled_ns += ktime_to_ns(ktime_sub(ktime_get(),
+				stats->enabled_since));
+
+		seq_printf(s, "%-3u %-8d %-8llu %-9llu %-9llu %-11llu %-17llu %-16llu",
+			clock_item->id, enabled,
+			stats->enable_count, stats->disable_count,
+			stats->failure_count, div_u64(enabled_ns, NSEC_PER_MSEC),
+			stats->last_set_rate_ns, stats->max_set_rate_ns);
+#ifdef CONFIG_DUMMY_CLK_MONITOR
+		seq_printf(s, " %-11lu %-11lu %lu",
+			stats->min_rate, stats->max_rate, stats->last_rate);
+#endif
+		seq_putc(s, '\n');
+		mutex_unlock(&clock_item->lock);
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(dummy_clk_stats);
+
+static int dummy_clk_registry_show(struct seq_file *s, void *unused)
+{
+	struct dummy_clk_shared *shared;
+	int bkt;
+
+	seq_puts(s, "clock                users  enabled  rate\n");
+
+	mutex_lock(&dummy_clk_registry_lock);
+	hash_for_each(dummy_clk_registry, bkt, shared, node)
+		seq_printf(s, "%-20s %-6u %-8u %lu\n",
+			clk_hw_get_name(shared->hw), shared->users,
+			shared->enable_count, shared->rate);
+	mutex_unlock(&dummy_clk_registry_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(dummy_clk_registry);
+#endif
+
+#ifdef CONFIG_DUMMY_CLK_BENCH
+static int dummy_clk_bench_cmp(const void *a, const void *b)
+{
+	u64 va = *(const u64 *)a;
+	u64 vb = *(const u64 *)b;
+
+	return va < vb ? -1 : va > vb;
+}
+
+static void dummy_clk_bench_summarize(struct dummy_clk_bench_result *result,
+	u64 *samples, u32 n)
+{
+	u64 total = 0;
+	u32 i;
+
+	for (i = 0; i < n; ++i)
+		total += samples[i];
+
+	sort(samples, n, sizeof(*samples), dummy_clk_bench_cmp, NULL);
+
+	result->ops_per_sec = total ? div64_u64((u64)n * NSEC_PER_SEC, total) : 0;
+	result->p50_ns = samples[n / 2];
+	result->p99_ns = samples[div_u64((u64)n * 99, 100)];
+	result->max_ns = samples[n - 1];
+}
+
+/*
+ * Pick the two rates the set_rate benchmark toggles between. Shared clocks
+ * are skipped, their rate belongs to the registry, and so are clocks whose
+ * table allows a single rate only. Called with the clock's lock held.
+ */
+static bool dummy_clk_bench_rates(struct dummy_clk_item *clock_item,
+	unsigned long rates[2])
+{
+	bool shared;
+
+	mutex_lock(&dummy_clk_registry_lock);
+	shared = clock_item->shared->users > 1;
+	mutex_unlock(&dummy_clk_registry_lock);
+	if (shared)
+		return false;
+
+	if (clock_item->n_opps) {
+		rates[0] = clock_item->opps[0].rate;
+		rates[1] = clock_item->opps[clock_item->n_opps - 1].rate;
+		return rates[0] != rates[1];
+	}
+
+	rates[0] = clock_item->frequency / 2;
+	rates[1] = clock_item->frequency;
+	return true;
+}
+
+/*
+ * Benchmark one clock: cycle it through the dummy_clk_enable() and
+ * dummy_clk_disable() paths, then toggle its rate between two allowed
+ * rates with the clock running. The previous state is restored
+ * afterwards. Called with the clock's lock held.
+ */
+static int dummy_clk_bench_item(struct dummy_clk_data *data,
+	struct dummy_clk_item *clock_item, u32 iterations, u64 *samples[])
+{
+	struct dummy_clk_bench_result *results =
+		&data->bench[clock_item->id * DUMMY_CLK_BENCH_NUM_OPS];
+	bool was_enabled = dummy_clk_is_on(clock_item);
+	unsigned long rates[2];
+	bool bench_rate;
+	ktime_t t0, t1, t2;
+	u32 i;
+	int err = 0;
+
+	dummy_clk_disable(data, clock_item);
+
+	for (i = 0; i < iterations; ++i) {
+		t0 = ktime_get();
+		err = dummy_clk_enable(data, clock_item);
+		t1 = ktime_get();
+		if (err < 0)
+			goto restore;
+		dummy_clk_disable(data, clock_item);
+		t2 = ktime_get();
+
+		samples[DUMMY_CLK_BENCH_ENABLE][i] = ktime_to_ns(ktime_sub(t1, t0));
+		samples[DUMMY_CLK_BENCH_DISABLE][i] = ktime_to_ns(ktime_sub(t2, t1));
+	}
+
+	bench_rate = dummy_clk_bench_rates(clock_item, rates);
+	if (!bench_rate)
+		goto summarize;
+
+	err = dummy_clk_enable(data, clock_item);
+	if (err < 0)
+		goto restore;
+
+	for (i = 0; i < iterations; ++i) {
+		t0 = ktime_get();
+		err = clk_set_rate(clock_item->clock, rates[i & 1]);
+		t1 = ktime_get();
+		if (err < 0)
+			goto restore;
+
+		samples[DUMMY_CLK_BENCH_SET_RATE][i] =
+			ktime_to_ns(ktime_sub(t1, t0));
+	}
+
+summarize:
+	for (i = 0; i < DUMMY_CLK_BENCH_NUM_OPS; ++i) {
+		if (i == DUMMY_CLK_BENCH_SET_RATE && !bench_rate)
+			continue;
+		dummy_clk_bench_summarize(&results[i], samples[i], iterations);
+	}
+
+restore:
+	/*
+	 * The clock is not shared, so the registry's rate still holds. Only
+	 * refresh the actual rate for dummy_clk_set_rate() to restore it.
+	 */
+	WRITE_ONCE(clock_item->actual_rate, clk_get_rate(clock_item->clock));
+	dummy_clk_set_rate(data, clock_item);
+	if (was_enabled)
+		dummy_clk_enable(data, clock_item);
+	else
+		dummy_clk_disable(data, clock_item);
+
+	return err;
+}
+
+static int dummy_clk_bench_run(struct dummy_clk_data *data, u32 iterations)
+{
+	struct device *dev = &data->pdev->dev;
+	u64 *samples[DUMMY_CLK_BENCH_NUM_OPS] = {};
+	int i;
+	int err = 0;
+
+	if (!data->bench) {
+		data->bench = devm_kcalloc(dev,
+			data->n_clocks * DUMMY_CLK_BENCH_NUM_OPS,
+			sizeof(*data->bench), GFP_KERNEL);
+		if (!data->bench)
+			return -ENOMEM;
+	}
 
-struct dummy_clk_item {
-	u32 id;
-	struct clk *clock;
-	u32 frequency;
-	bool enabled;
-};
+	for (i = 0; i < DUMMY_CLK_BENCH_NUM_OPS; ++i) {
+		samples[i] = kvmalloc_array(iterations, sizeof(u64), GFP_KERNEL);
+		if (!samples[i]) {
+			err = -ENOMEM;
+			goto out_free;
+		}
+	}
 
-struct dummy_clk_data {
-	struct platform_device *pdev;
-	struct dummy_clk_item *clocks;
-	u32 n_clocks;
-};
+	err = pm_runtime_get_sync(dev);
+	if (err < 0) {
+		pm_runtime_put_noidle(dev);
+		goto out_free;
+	}
 
-static int dummy_clk_enable(struct dummy_clk_data *data,
-	struct dummy_clk_item *clock_item)
+	mutex_lock(&data->lock);
+	memset(data->bench, 0, data->n_clocks * DUMMY_CLK_BENCH_NUM_OPS *
+		sizeof(*data->bench));
+	data->bench_iterations = iterations;
+	for (i = 0; i < data->n_clocks; ++i) {
+		mutex_lock(&data->clocks[i].lock);
+		err = dummy_clk_bench_item(data, &data->clocks[i], iterations,
+			samples);
+		mutex_unlock(&data->clocks[i].lock);
+		if (err < 0) {
+			dev_err(dev, "Benchmark failed on clock %u\n", i);
+			break;
+		}
+	}
+	mutex_unlock(&data->lock);
+
+	pm_runtime_mark_last_busy(dev);
+	pm_runtime_put_autosuspend(dev);
+
+out_free:
+	for (i = 0; i < DUMMY_CLK_BENCH_NUM_OPS; ++i)
+		kvfree(samples[i]);
+	return err < 0 ? err : 0;
+}
+
+static int dummy_clk_bench_show(struct seq_file *s, void *unused)
+{
+	struct dummy_clk_data *data = s->private;
+	int i;
+	int op;
+
+	mutex_lock(&data->lock);
+	if (!data->bench) {
+		seq_puts(s, "No benchmark run yet, write an iteration count\n");
+		goto out;
+	}
+
+	seq_printf(s, "iterations: %u\n", data->bench_iterations);
+	seq_puts(s, "id  op        ops/sec     p50_ns      p99_ns      max_ns\n");
+	for (i = 0; i < data->n_clocks; ++i) {
+		for (op = 0; op < DUMMY_CLK_BENCH_NUM_OPS; ++op) {
+			struct dummy_clk_bench_result *result =
+				&data->bench[i * DUMMY_CLK_BENCH_NUM_OPS + op];
+
+			seq_printf(s, "%-3u %-9s %-11llu %-11llu %-11llu %llu\n",
+				i, dummy_clk_bench_op_names[op],
+				result->ops_per_sec, result->p50_ns,
+				result->p99_ns, result->max_ns);
+		}
+	}
+out:
+	mutex_unlock(&data->lock);
+
+	return 0;
+}
+
+static int dummy_clk_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dummy_clk_bench_show, inode->i_private);
+}
+
+/* Writing an iteration count runs the benchmark on every clock */
+static ssize_t dummy_clk_bench_write(struct file *file,
+	const char __user *ubuf, size_t count, loff_t *ppos)
 {
+	struct seq_file *s = file->private_data;
+	u32 iterations;
 	int err;
 
-	if (clock_item->enabled)
-		return 0;
+	err = kstrtou32_from_user(ubuf, count, 0, &iterations);
+	if (err)
+		return err;
 
-	err = clk_set_rate(clock_item->clock,
-		clock_item->frequency);
-	if (err < 0) {
-		dev_err(&data->pdev->dev,
-			"Failed to set clock frequency of clock %u to %u Hz\n",
-			clock_item->id, clock_item->frequency);
+	if (iterations == 0 || iterations > DUMMY_CLK_BENCH_MAX_ITERATIONS)
+		return -EINVAL;
+
+	err = dummy_clk_bench_run(s->private, iterations);
+	if (err)
 		return err;
+
+	return count;
+}
+
+static const struct file_operations dummy_clk_bench_fops = {
+	.owner = THIS_MODULE,
+	.open = dummy_clk_bench_open,
+	.read = seq_read,
+	.write = dummy_clk_bench_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif
+
+#ifdef CONFIG_DUMMY_CLK_PROVIDER
+/* Latency knobs for each output clock in provider mode */
+static void dummy_clk_debugfs_init_outputs(struct dummy_clk_data *data)
+{
+	struct dummy_clk_provider *provider = data->provider;
+	struct dentry *outputs_dir;
+	struct dentry *dir;
+	int i;
+
+	outputs_dir = debugfs_create_dir("outputs", data->debugfs_dir);
+	for (i = 0; i < provider->n_outputs; ++i) {
+		struct dummy_clk_output *output = &provider->outputs[i];
+
+		dir = debugfs_create_dir(clk_hw_get_name(&output->hw),
+			outputs_dir);
+		debugfs_create_u32("prepare_delay_us", 0644, dir,
+			&output->prepare_delay_us);
+		debugfs_create_u32("enable_delay_us", 0644, dir,
+			&output->enable_delay_us);
+		debugfs_create_u32("set_rate_delay_us", 0644, dir,
+			&output->set_rate_delay_us);
+		debugfs_create_u32("jitter_us", 0644, dir, &output->jitter_us);
+		debugfs_create_bool("busy_wait", 0644, dir, &output->busy_wait);
 	}
+}
+#endif
 
-	err = clk_prepare_enable(clock_item->clock);
-	if (err < 0) {
-		dev_err(&data->pdev->dev, "Failed to enable clock %u\n",
-			clock_item->id);
-		return err;
+static void dummy_clk_debugfs_init(struct dummy_clk_data *data)
+{
+	data->debugfs_dir = debugfs_create_dir(dev_name(&data->pdev->dev),
+		dummy_clk_debugfs_root);
+#ifdef CONFIG_DUMMY_CLK_STATS
+	debugfs_create_file("stats", 0444, data->debugfs_dir, data,
+		&dummy_clk_stats_fops);
+#endif
+#ifdef CONFIG_DUMMY_CLK_BENCH
+	debugfs_create_file("benchmark", 0600, data->debugfs_dir, data,
+		&dummy_clk_bench_fops);
+#endif
+#ifdef CONFIG_DUMMY_CLK_PROVIDER
+	if (data->provider)
+		dummy_clk_debugfs_init_outputs(data);
+#endif
+}
+
+/* ------------------------------------------------------------------ */
+
+#ifdef CONFIG_DUMMY_CLK_PROVIDER
+/*
+ * Inject a delay of delay_us plus jitter. The enable path runs in atomic
+ * context and always spins, the others sleep unless busy-wait is set.
+ */
+static void dummy_clk_output_delay(struct dummy_clk_output *output,
+	u32 delay_us, bool atomic)
+{
+	u32 jitter_us = READ_ONCE(output->jitter_us);
+
+	if (jitter_us)
+		delay_us += get_random_u32_inclusive(0, jitter_us);
+	if (!delay_us)
+		return;
+
+	if (atomic || READ_ONCE(output->busy_wait)) {
+		mdelay(delay_us / USEC_PER_MSEC);
+		udelay(delay_us % USEC_PER_MSEC);
+	} else {
+		fsleep(delay_us);
 	}
+}
 
-	dev_info(&data->pdev->dev, "Clock %u enabled at %lu Hz\n",
-		clock_item->id, clk_get_rate(clock_item->clock));
+static int dummy_clk_output_prepare(struct clk_hw *hw)
+{
+	struct dummy_clk_output *output = to_dummy_clk_output(hw);
+
+	dummy_clk_output_delay(output, READ_ONCE(output->prepare_delay_us),
+		false);
+	output->prepared = true;
+	return 0;
+}
+
+static void dummy_clk_output_unprepare(struct clk_hw *hw)
+{
+	to_dummy_clk_output(hw)->prepared = false;
+}
+
+static int dummy_clk_output_is_prepared(struct clk_hw *hw)
+{
+	return to_dummy_clk_output(hw)->prepared;
+}
 
-	clock_item->enabled = true;
+static int dummy_clk_output_enable(struct clk_hw *hw)
+{
+	struct dummy_clk_output *output = to_dummy_clk_output(hw);
 
+	dummy_clk_output_delay(output, READ_ONCE(output->enable_delay_us),
+		true);
+	output->enabled = true;
 	return 0;
 }
 
-static void dummy_clk_disable(struct dummy_clk_data *data,
-	struct dummy_clk_item *clock_item)
+static void dummy_clk_output_disable(struct clk_hw *hw)
 {
-	if (!clock_item->enabled)
-		return;
+	to_dummy_clk_output(hw)->enabled = false;
+}
 
-	clk_disable_unprepare(clock_item->clock);
+static int dummy_clk_output_is_enabled(struct clk_hw *hw)
+{
+	return to_dummy_clk_output(hw)->enabled;
+}
+
+static unsigned long dummy_clk_output_recalc_rate(struct clk_hw *hw,
+	unsigned long parent_rate)
+{
+	return to_dummy_clk_output(hw)->rate;
+}
+
+/* Any non-zero rate is achievable exactly */
+static int dummy_clk_output_determine_rate(struct clk_hw *hw,
+	struct clk_rate_request *req)
+{
+	if (req->rate == 0)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int dummy_clk_output_set_rate(struct clk_hw *hw, unsigned long rate,
+	unsigned long parent_rate)
+{
+	struct dummy_clk_output *output = to_dummy_clk_output(hw);
+
+	dummy_clk_output_delay(output, READ_ONCE(output->set_rate_delay_us),
+		false);
+	output->rate = rate;
+	return 0;
+}
+
+static const struct clk_ops dummy_clk_output_ops = {
+	.prepare = dummy_clk_output_prepare,
+	.unprepare = dummy_clk_output_unprepare,
+	.is_prepared = dummy_clk_output_is_prepared,
+	.enable = dummy_clk_output_enable,
+	.disable = dummy_clk_output_disable,
+	.is_enabled = dummy_clk_output_is_enabled,
+	.recalc_rate = dummy_clk_output_recalc_rate,
+	.determine_rate = dummy_clk_output_determine_rate,
+	.set_rate = dummy_clk_output_set_rate,
+};
+
+/*
+ * Provider mode: a node with "#clock-cells" registers one synthetic clock
+ * per "clock-output-names" entry, with initial rates from
+ * "topic,output-frequencies". Optional per-output "topic,prepare-delay-us",
+ * "topic,enable-delay-us", "topic,set-rate-delay-us" and
+ * "topic,delay-jitter-us" arrays inject latency, a non-zero
+ * "topic,delay-busy-wait" entry makes the sleeping paths of that output
+ * spin. This happens before the consumer side looks up its clocks, so a
+ * node may consume its own outputs.
+ */
+static int dummy_clk_provider_register(struct platform_device *pdev,
+	struct dummy_clk_provider **result)
+{
+	struct device_node *np = pdev->dev.of_node;
+	struct dummy_clk_provider *provider;
+	struct clk_init_data init = {};
+	const char *name;
+	u32 busy_wait;
+	u32 rate;
+	int n_outputs;
+	int i;
+	int ret;
+
+	*result = NULL;
+	if (!of_find_property(np, "#clock-cells", NULL))
+		return 0;
+
+	n_outputs = of_property_count_strings(np, "clock-output-names");
+	if (n_outputs <= 0) {
+		dev_err(&pdev->dev, "Provider mode needs clock-output-names\n");
+		return -EINVAL;
+	}
+
+	provider = devm_kzalloc(&pdev->dev,
+		struct_size(provider, outputs, n_outputs), GFP_KERNEL);
+	if (!provider)
+		return -ENOMEM;
+	provider->n_outputs = n_outputs;
+
+	provider->onecell = devm_kzalloc(&pdev->dev,
+		struct_size(provider->onecell, hws, n_outputs), GFP_KERNEL);
+	if (!provider->onecell)
+		return -ENOMEM;
+	provider->onecell->num = n_outputs;
+
+	for (i = 0; i < n_outputs; ++i) {
+		struct dummy_clk_output *output = &provider->outputs[i];
 
-	dev_info(&data->pdev->dev, "Clock %u disabled\n", clock_item->id);
-	clock_item->enabled = false;
+		of_property_read_string_index(np, "clock-output-names", i,
+			&name);
+		ret = of_property_read_u32_index(np, "topic,output-frequencies",
+			i, &rate);
+		if (ret) {
+			dev_err(&pdev->dev,
+				"Devicetree topic,output-frequencies missing for output %u\n",
+				i);
+			return -EINVAL;
+		}
+
+		output->rate = rate;
+		of_property_read_u32_index(np, "topic,prepare-delay-us", i,
+			&output->prepare_delay_us);
+		of_property_read_u32_index(np, "topic,enable-delay-us", i,
+			&output->enable_delay_us);
+		of_property_read_u32_index(np, "topic,set-rate-delay-us", i,
+			&output->set_rate_delay_us);
+		of_property_read_u32_index(np, "topic,delay-jitter-us", i,
+			&output->jitter_us);
+		busy_wait = 0;
+		of_property_read_u32_index(np, "topic,delay-busy-wait", i,
+			&busy_wait);
+		output->busy_wait = busy_wait;
+
+		init.name = name;
+		init.ops = &dummy_clk_output_ops;
+		init.num_parents = 0;
+		init.flags = 0;
+		output->hw.init = &init;
+
+		ret = devm_clk_hw_register(&pdev->dev, &output->hw);
+		if (ret) {
+			dev_err(&pdev->dev, "Could not register output %s\n",
+				name);
+			return ret;
+		}
+		provider->onecell->hws[i] = &output->hw;
+	}
+
+	ret = devm_of_clk_add_hw_provider(&pdev->dev, of_clk_hw_onecell_get,
+		provider->onecell);
+	if (ret) {
+		dev_err(&pdev->dev, "Could not add clock provider\n");
+		return ret;
+	}
+
+	dummy_clk_dbg(&pdev->dev, "Registered %u output clocks\n",
+		n_outputs);
+	*result = provider;
+
+	return 0;
+}
+#else
+static int dummy_clk_provider_register(struct platform_device *pdev,
+	struct dummy_clk_provider **result)
+{
+	*result = NULL;
+	if (of_find_property(pdev->dev.of_node, "#clock-cells", NULL))
+		dev_warn(&pdev->dev, "Built without provider mode\n");
+
+	return 0;
 }
+#endif
+
+/* ------------------------------------------------------------------ */
 
 static int dummy_clk_probe(struct platform_device *pdev)
 {
 	struct dummy_clk_data *data;
+	struct dummy_clk_provider *provider;
+	struct clk_bulk_data *bulk;
+	u32 n_clocks;
 	int i;
 	int ret;
-	u32 *tmp;
+	u32 idle_timeout = DUMMY_CLK_DEFAULT_IDLE_TIMEOUT_MS;
+	u32 n_enabled;
+	u32 n_degraded;
 
-	dev_info(&pdev->dev, "Dummy clk driver probing...\n");
+	dummy_clk_dbg(&pdev->dev, "Dummy clk driver probing...\n");
 
-	data = devm_kzalloc(&pdev->dev, sizeof(*data),
-		GFP_KERNEL);
+	ret = dummy_clk_provider_register(pdev, &provider);
+	if (ret)
+		return ret;
+
+	/*
+	 * Look up all clocks in the devicetree in a single pass. The
+	 * references are released automatically on unbind or probe failure.
+	 */
+	ret = devm_clk_bulk_get_all(&pdev->dev, &bulk);
+	if (ret < 0) {
+		if (ret != -EPROBE_DEFER)
+			dev_err(&pdev->dev, "Could not get clocks: %d\n", ret);
+		return ret;
+	}
+	n_clocks = ret;
+	if (n_clocks == 0 && !provider) {
+		dev_info(&pdev->dev, "No clocks found in devicetree\n");
+		return -EINVAL;
+	}
+	dummy_clk_dbg(&pdev->dev, "Found %u clocks in devicetree\n", n_clocks);
+
+	/*
+	 * Driver data and the clock items share a single allocation. It is
+	 * refcounted rather than devm managed, open files may outlive the
+	 * device.
+	 */
+	data = kzalloc(struct_size(data, clocks, n_clocks), GFP_KERNEL);
 	if (!data)
 		return -ENOMEM;
+	kref_init(&data->kref);
+	init_rwsem(&data->fops_lock);
+	ret = devm_add_action_or_reset(&pdev->dev, dummy_clk_data_put, data);
+	if (ret)
+		return ret;
 
 	/* Connect driver data to platform device */
 	platform_set_drvdata(pdev, data);
 	data->pdev = pdev;
+	data->bulk = bulk;
+	data->n_clocks = n_clocks;
+	data->provider = provider;
+	mutex_init(&data->lock);
+	spin_lock_init(&data->event_lock);
+	init_completion(&data->async_done);
 
-	/* Check number of clocks in devicetree */
-	data->n_clocks = of_clk_get_parent_count(pdev->dev.of_node);
-	if (data->n_clocks == 0) {
-		dev_info(&pdev->dev, "No clocks found in devicetree\n");
-		return -EINVAL;
+	/* Get clock-info and frequencies from devicetree */
+	for (i = 0; i < data->n_clocks; ++i) {
+		data->clocks[i].clock = data->bulk[i].clk;
+		data->clocks[i].clk_name = data->bulk[i].id;
+		data->clocks[i].id = i;
+		mutex_init(&data->clocks[i].lock);
+		data->clocks[i].state = DUMMY_CLK_STATE_OFF;
+		data->clocks[i].data = data;
+#ifdef CONFIG_DUMMY_CLK_RETRY
+		INIT_DELAYED_WORK(&data->clocks[i].retry_work,
+			dummy_clk_retry_work);
+#endif
+
+		ret = of_property_read_u32_index(pdev->dev.of_node,
+			"clock-frequencies", i, &data->clocks[i].frequency);
+		if (ret) {
+			dev_err(&pdev->dev,
+				"Devicetree clock-frequencies missing for clock %u\n",
+				i);
+			return -EINVAL;
+		}
+		dummy_clk_dbg(&pdev->dev, "Got frequency %u Hz for clock %u\n",
+			data->clocks[i].frequency, i);
 	}
-	dev_info(&pdev->dev, "Found %u clocks in devicetree\n", data->n_clocks);
 
-	/* Allocate memory for clock data */
-	data->clocks = devm_kmalloc_array(&pdev->dev, data->n_clocks,
-		sizeof(struct dummy_clk_item), GFP_KERNEL);
-	if (!data->clocks)
-		return -ENOMEM;
+	ret = dummy_clk_names_init(data);
+	if (ret)
+		return ret;
+
+	ret = dummy_clk_opp_init(data);
+	if (ret)
+		return ret;
 
-	/* Get clock-info from devicetree */
+	ret = dummy_clk_profiles_init(data);
+	if (ret)
+		return ret;
+
+	ret = dummy_clk_status_init(data);
+	if (ret)
+		return ret;
+
+	/* Hook the clocks up to the module-wide registry */
+	ret = devm_add_action_or_reset(&pdev->dev, dummy_clk_shared_put_all,
+		data);
+	if (ret)
+		return ret;
 	for (i = 0; i < data->n_clocks; ++i) {
+		data->clocks[i].shared =
+			dummy_clk_shared_get(data->clocks[i].clock);
+		if (!data->clocks[i].shared)
+			return -ENOMEM;
+	}
+
+	/* Sweeps restore their rate through the registry on teardown */
+	ret = dummy_clk_sweep_init(data);
+	if (ret)
+		return ret;
 
-		/* Get clock */
-		data->clocks[i].clock = of_clk_get(pdev->dev.of_node, i);
-		if (data->clocks[i].clock == NULL) {
-			dev_err(&pdev->dev, "Could not get clock %u\n",	i);
+	of_property_read_u32(pdev->dev.of_node, "topic,rate-tolerance-hz",
+		&data->rate_tolerance);
+	data->reassert_rate = of_property_read_bool(pdev->dev.of_node,
+		"topic,reassert-rate");
+	data->allow_degraded = of_property_read_bool(pdev->dev.of_node,
+		"topic,allow-degraded");
+
+	ret = of_property_count_u32_elems(pdev->dev.of_node,
+		"topic,glitch-free-clocks");
+	for (i = 0; i < ret; ++i) {
+		u32 id;
+
+		of_property_read_u32_index(pdev->dev.of_node,
+			"topic,glitch-free-clocks", i, &id);
+		if (id >= n_clocks) {
+			dev_err(&pdev->dev, "Glitch-free clock %u does not exist\n",
+				id);
 			return -EINVAL;
 		}
-
-		data->clocks[i].id = i;
-		data->clocks[i].enabled = false;
+		data->clocks[id].gate_retune = true;
 	}
 
-	/* Get frequencies */
-	/* Get complete array and put in tmp array */
-	tmp = kmalloc_array(data->n_clocks, sizeof(u32), GFP_KERNEL);
-	ret = of_property_read_u32_array(pdev->dev.of_node, "clock-frequencies",
-		tmp, data->n_clocks);
-	if (ret) {
-		dev_err(&pdev->dev,
-			"Devicetree clock-frequencies missing for clock %u\n",
-			i);
-		return -EINVAL;
-	}
+	ret = dummy_clk_notifiers_register(data);
+	if (ret)
+		return ret;
 
-	/* Copy frequencies to data struct and free tmp array */
-	for (i = 0; i < data->n_clocks; ++i) {
-		data->clocks[i].frequency = tmp[i];
-		dev_info(&pdev->dev, "Got frequency %u Hz for clock %u\n",
-		data->clocks[i].frequency, i);
+	ret = dummy_clk_meas_init(data);
+	if (ret)
+		return ret;
+
+	ret = devm_add_action_or_reset(&pdev->dev, dummy_clk_retry_cancel_all,
+		data);
+	if (ret)
+		return ret;
+
+	/*
+	 * In lazy mode clocks are only enabled when claimed through sysfs,
+	 * and runtime PM gates them again after the idle timeout.
+	 */
+	data->lazy_enable = of_property_read_bool(pdev->dev.of_node,
+		"topic,lazy-enable");
+#ifndef CONFIG_DUMMY_CLK_SYSFS
+	/* Nothing could ever claim the clocks, enable them all instead */
+	if (data->lazy_enable) {
+		dev_warn(&pdev->dev,
+			"Built without sysfs, ignoring topic,lazy-enable\n");
+		data->lazy_enable = false;
 	}
-	kfree(tmp);
+#endif
+	if (data->lazy_enable) {
+		of_property_read_u32(pdev->dev.of_node, "topic,idle-timeout-ms",
+			&idle_timeout);
+		pm_runtime_set_autosuspend_delay(&pdev->dev, idle_timeout);
+		pm_runtime_use_autosuspend(&pdev->dev);
+		pm_runtime_enable(&pdev->dev);
+	} else {
+		/*
+		 * Configure and enable all clocks. Boards whose clocks are
+		 * independent can opt in to parallel bring-up, or describe
+		 * stages of clocks that can come up together. The default
+		 * remains index order.
+		 */
+		data->parallel_enable = of_property_read_bool(
+			pdev->dev.of_node, "topic,parallel-enable");
+		if (of_find_property(pdev->dev.of_node,
+				"topic,clock-enable-stages", NULL)) {
+			for (i = 0; i < data->n_clocks; ++i)
+				of_property_read_u32_index(pdev->dev.of_node,
+					"topic,clock-enable-stages", i,
+					&data->clocks[i].stage);
+			data->parallel_enable = true;
+		}
+		if (of_property_read_bool(pdev->dev.of_node,
+				"topic,adopt-boot-clocks"))
+			dummy_clk_adopt_boot_clocks(data);
+		if (data->parallel_enable) {
+			ret = dummy_clk_enable_all_parallel(data);
+		} else {
+			dummy_clk_lock_all(data);
+			dummy_clk_event_batch_begin(data);
+			ret = dummy_clk_enable_all_serial(data);
+			dummy_clk_event_batch_end(data);
+			dummy_clk_unlock_all(data);
+		}
+		if (ret) {
+			/* Release adopted clocks as well */
+			dummy_clk_lock_all(data);
+			for (i = 0; i < data->n_clocks; ++i)
+				dummy_clk_disable(data, &data->clocks[i]);
+			dummy_clk_unlock_all(data);
+			return ret;
+		}
 
-	/* Configure and enable all clocks */
-	for (i = 0; i < data->n_clocks; ++i) {
-		if (dummy_clk_enable(data, &data->clocks[i]) != 0) {
-			dev_err(&pdev->dev, "Could not enable clock %u\n", i);
-			return -EINVAL;
+		/* Hold a usage reference so runtime PM never gates them */
+		pm_runtime_get_noresume(&pdev->dev);
+		pm_runtime_set_active(&pdev->dev);
+		pm_runtime_enable(&pdev->dev);
+
+		/* Verify the real frequencies, failures are only reported */
+#ifdef CONFIG_DUMMY_CLK_MONITOR
+		if (data->meas_regmap) {
+			dummy_clk_lock_all(data);
+			dummy_clk_meas_run(data);
+			dummy_clk_unlock_all(data);
 		}
+#endif
 	}
 
-	dev_info(&pdev->dev, "clk-dummy-driver probed, enabled %u clocks\n",
-		data->n_clocks);
+	ret = dummy_clk_sysfs_init(data);
+	if (ret)
+		goto err_pm;
+
+	ret = dummy_clk_miscdev_register(data);
+	if (ret) {
+		dev_err(&pdev->dev, "Could not register character device\n");
+		goto err_sysfs;
+	}
+
+	dummy_clk_debugfs_init(data);
+
+	ret = dummy_clk_monitor_start(data);
+	if (ret)
+		goto err_misc;
+
+	/* One summary line instead of a message per clock */
+	for (i = 0, n_enabled = 0, n_degraded = 0; i < data->n_clocks; ++i) {
+		if (dummy_clk_is_on(&data->clocks[i]))
+			++n_enabled;
+		if (data->clocks[i].degraded)
+			++n_degraded;
+	}
+	dev_info(&pdev->dev,
+		"clk-dummy-driver probed, %u clocks, %u enabled, %u degraded (%s)\n",
+		data->n_clocks, n_enabled, n_degraded,
+		data->lazy_enable ? "on demand" :
+		data->parallel_enable ? "parallel" : "serial");
 
 	return 0;
+
+err_misc:
+	debugfs_remove_recursive(data->debugfs_dir);
+	dummy_clk_miscdev_unregister(data);
+	dummy_clk_sweep_stop_all(data);
+err_sysfs:
+	dummy_clk_sysfs_remove(data, data->n_clocks);
+err_pm:
+	pm_runtime_disable(&pdev->dev);
+	if (data->lazy_enable)
+		pm_runtime_dont_use_autosuspend(&pdev->dev);
+	else
+		pm_runtime_put_noidle(&pdev->dev);
+	pm_runtime_set_suspended(&pdev->dev);
+	dummy_clk_retry_cancel_all(data);
+	dummy_clk_lock_all(data);
+	for (i = 0; i < data->n_clocks; ++i)
+		dummy_clk_disable(data, &data->clocks[i]);
+	dummy_clk_unlock_all(data);
+	return ret;
 }
 
 /* ------------------------------------------------------------------ */
 
 static int dummy_clk_remove(struct platform_device *pdev)
 {
-	struct dummy_clk_data *data = dev_get_platdata(&pdev->dev);
+	struct dummy_clk_data *data = platform_get_drvdata(pdev);
 	int i;
 
+	dummy_clk_sysfs_remove(data, data->n_clocks);
+	debugfs_remove_recursive(data->debugfs_dir);
+	dummy_clk_miscdev_unregister(data);
+	dummy_clk_sweep_stop_all(data);
+	dummy_clk_retry_cancel_all(data);
+
+	pm_runtime_disable(&pdev->dev);
+	if (data->lazy_enable)
+		pm_runtime_dont_use_autosuspend(&pdev->dev);
+	else
+		pm_runtime_put_noidle(&pdev->dev);
+	pm_runtime_set_suspended(&pdev->dev);
+
+	dummy_clk_lock_all(data);
 	for (i = 0; i < data->n_clocks; ++i)
 		dummy_clk_disable(data, &data->clocks[i]);
+	dummy_clk_unlock_all(data);
+
+	return 0;
+}
+
+/* ------------------------------------------------------------------ */
+
+static int __maybe_unused dummy_clk_runtime_suspend(struct device *dev)
+{
+	struct dummy_clk_data *data = dev_get_drvdata(dev);
+	int i;
+
+	for (i = 0; i < data->n_clocks; ++i) {
+		mutex_lock(&data->clocks[i].lock);
+		dummy_clk_disable(data, &data->clocks[i]);
+		mutex_unlock(&data->clocks[i].lock);
+	}
+
+	return 0;
+}
+
+static int __maybe_unused dummy_clk_runtime_resume(struct device *dev)
+{
+	/* Clocks are enabled on demand by dummy_clk_claim() */
+	return 0;
+}
+
+/*
+ * Gate every enabled clock for system sleep and remember which ones to
+ * bring back, so resume restores exactly the pre-suspend state.
+ */
+static int __maybe_unused dummy_clk_suspend(struct device *dev)
+{
+	struct dummy_clk_data *data = dev_get_drvdata(dev);
+	int i;
+
+	dummy_clk_lock_all(data);
+	dummy_clk_event_batch_begin(data);
+	for (i = 0; i < data->n_clocks; ++i) {
+		struct dummy_clk_item *clock_item = &data->clocks[i];
+
+		clock_item->resume_enable = dummy_clk_is_on(clock_item);
+		if (!clock_item->resume_enable)
+			continue;
+
+		dummy_clk_disable_unprepare(clock_item);
+		dummy_clk_set_state(clock_item, DUMMY_CLK_STATE_OFF);
+		dummy_clk_publish(clock_item);
+	}
+	dummy_clk_event_batch_end(data);
+	dummy_clk_unlock_all(data);
 
 	return 0;
 }
 
+/*
+ * Fast resume path: the rate normally survives suspend, so only reprogram
+ * it when the provider lost it, and just re-enable the clock otherwise.
+ */
+static int __maybe_unused dummy_clk_resume(struct device *dev)
+{
+	struct dummy_clk_data *data = dev_get_drvdata(dev);
+	int i;
+	int err;
+	int ret = 0;
+
+	dummy_clk_lock_all(data);
+	dummy_clk_event_batch_begin(data);
+	for (i = 0; i < data->n_clocks; ++i) {
+		struct dummy_clk_item *clock_item = &data->clocks[i];
+
+		if (!clock_item->resume_enable)
+			continue;
+		clock_item->resume_enable = false;
+
+		err = dummy_clk_set_rate(data, clock_item);
+		if (err == 0)
+			err = dummy_clk_prepare_enable(clock_item);
+		if (err < 0) {
+			dev_err(dev, "Failed to re-enable clock %u\n",
+				clock_item->id);
+			dummy_clk_set_state(clock_item, DUMMY_CLK_STATE_FAILED);
+			dummy_clk_publish(clock_item);
+			ret = ret ? ret : err;
+			continue;
+		}
+		dummy_clk_set_state(clock_item, DUMMY_CLK_STATE_ON);
+		dummy_clk_publish(clock_item);
+	}
+	dummy_clk_event_batch_end(data);
+	dummy_clk_unlock_all(data);
+
+	return ret;
+}
+
+static const struct dev_pm_ops dummy_clk_pm_ops = {
+	SET_SYSTEM_SLEEP_PM_OPS(dummy_clk_suspend, dummy_clk_resume)
+	SET_RUNTIME_PM_OPS(dummy_clk_runtime_suspend,
+		dummy_clk_runtime_resume, NULL)
+};
+
 /* ------------------------------------------------------------------ */
 
 static const struct of_device_id dummy_clk_id[] = {
@@ -185,7 +4083,47 @@ static struct platform_driver dummy_clk_drvr = {
 		.name = DRIVER_NAME,
 		.owner = THIS_MODULE,
 		.of_match_table = dummy_clk_id,
+		.pm = &dummy_clk_pm_ops,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 };
 
-module_platform_driver(dummy_clk_drvr);
+static int __init dummy_clk_init(void)
+{
+	int ret;
+
+	ret = dummy_clk_sweep_wq_create();
+	if (ret)
+		return ret;
+
+	ret = genl_register_family(&dummy_clk_genl_family);
+	if (ret) {
+		dummy_clk_sweep_wq_destroy();
+		return ret;
+	}
+
+	dummy_clk_debugfs_root = debugfs_create_dir("dummy-clk", NULL);
+#ifdef CONFIG_DUMMY_CLK_STATS
+	debugfs_create_file("registry", 0444, dummy_clk_debugfs_root, NULL,
+		&dummy_clk_registry_fops);
+#endif
+
+	ret = platform_driver_register(&dummy_clk_drvr);
+	if (ret) {
+		debugfs_remove_recursive(dummy_clk_debugfs_root);
+		genl_unregister_family(&dummy_clk_genl_family);
+		dummy_clk_sweep_wq_destroy();
+	}
+
+	return ret;
+}
+module_init(dummy_clk_init);
+
+static void __exit dummy_clk_exit(void)
+{
+	platform_driver_unregister(&dummy_clk_drvr);
+	debugfs_remove_recursive(dummy_clk_debugfs_root);
+	genl_unregister_family(&dummy_clk_genl_family);
+	dummy_clk_sweep_wq_destroy();
+}
+module_exit(dummy_clk_exit);
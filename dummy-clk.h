@@ -0,0 +1,152 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * Userspace interface of the dummy clk driver
+ *
+ * Copyright 2020 TOPIC Embedded Products. All rights reserved.
+ *
+ */
+
+#ifndef _UAPI_DUMMY_CLK_H
+#define _UAPI_DUMMY_CLK_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/* One requested change of a transaction */
+struct dummy_clk_update {
+	__u32 id;		/* Clock index */
+	__u32 frequency;	/* Requested rate in Hz, 0 keeps the current one */
+	__u32 enable;		/* 1 to run the clock, 0 to gate it */
+	__u32 reserved;		/* Must be zero */
+};
+
+/*
+ * A set of updates applied in one pass. Either all updates take effect,
+ * or the clocks are rolled back to their previous state. Clocks already
+ * in the requested state are not touched.
+ */
+struct dummy_clk_transaction {
+	__u32 n_updates;
+	__u32 reserved;		/* Must be zero */
+	__u64 updates;		/* Pointer to struct dummy_clk_update[] */
+};
+
+/* Translate a "clock-names" entry into a clock index */
+struct dummy_clk_lookup {
+	char name[32];		/* In: clock name */
+	__u32 id;		/* Out: clock index */
+};
+
+/*
+ * Read-only status page, mmap()ed from the character device at offset 0.
+ * The header is followed by n_clocks entries of entry_size bytes each.
+ * seq is odd while the driver updates the page; readers copy what they
+ * need and retry when seq was odd or changed in the meantime.
+ */
+struct dummy_clk_status_header {
+	__u32 seq;
+	__u32 n_clocks;
+	__u32 entry_size;
+	__u32 reserved;
+};
+
+/* Life cycle of a clock, as in dummy_clk_status_entry.state */
+enum {
+	DUMMY_CLK_STATE_OFF,
+	DUMMY_CLK_STATE_PREPARING,	/* Being programmed and enabled */
+	DUMMY_CLK_STATE_ON,
+	DUMMY_CLK_STATE_FAILED,		/* Last attempt to enable it failed */
+};
+
+struct dummy_clk_status_entry {
+	__u32 id;
+	__u32 enabled;
+	__u32 degraded;
+	__u32 frequency;	/* Requested rate in Hz */
+	__u64 actual_rate;	/* As reported by the clock framework */
+	__u64 measured_rate;	/* From the frequency counter, 0 if none */
+	__u64 enable_count;
+	__u64 disable_count;
+	__u64 failure_count;
+	__u64 enabled_ns;	/* Excluding the current enabled period */
+	__u64 last_set_rate_ns;
+	__u64 max_set_rate_ns;
+	__u32 state;		/* DUMMY_CLK_STATE_* */
+	__u32 reserved;
+};
+
+/*
+ * Generic netlink event stream. Every message on the "events" multicast
+ * group carries the device name and one or more nested events; changes
+ * made by a single transaction arrive together in one message.
+ */
+#define DUMMY_CLK_GENL_NAME		"dummy_clk"
+#define DUMMY_CLK_GENL_VERSION		1
+#define DUMMY_CLK_GENL_MCGRP_NAME	"events"
+
+enum {
+	DUMMY_CLK_CMD_UNSPEC,
+	DUMMY_CLK_CMD_EVENT,
+};
+
+enum {
+	DUMMY_CLK_A_UNSPEC,
+	DUMMY_CLK_A_DEVICE,		/* string */
+	DUMMY_CLK_A_EVENT,		/* nested, repeated */
+	__DUMMY_CLK_A_MAX,
+};
+#define DUMMY_CLK_A_MAX (__DUMMY_CLK_A_MAX - 1)
+
+enum {
+	DUMMY_CLK_A_EVENT_UNSPEC,
+	DUMMY_CLK_A_EVENT_TYPE,		/* u32, DUMMY_CLK_EVENT_* */
+	DUMMY_CLK_A_EVENT_ID,		/* u32, clock index */
+	DUMMY_CLK_A_EVENT_RATE,		/* u64, rate in Hz */
+	DUMMY_CLK_A_EVENT_ERROR,	/* s32, negative errno */
+	__DUMMY_CLK_A_EVENT_MAX,
+};
+#define DUMMY_CLK_A_EVENT_MAX (__DUMMY_CLK_A_EVENT_MAX - 1)
+
+enum {
+	DUMMY_CLK_EVENT_ENABLE,
+	DUMMY_CLK_EVENT_DISABLE,
+	DUMMY_CLK_EVENT_RATE_CHANGE,
+	DUMMY_CLK_EVENT_FAILURE,
+};
+
+/*
+ * In-kernel frequency sweep: step a clock from start to stop (either
+ * direction) in steps of step Hz, holding each rate for dwell_us. The
+ * clock must be enabled, and the sweep ends early if it is turned off.
+ */
+struct dummy_clk_sweep_config {
+	__u32 id;
+	__u32 start;		/* First rate in Hz */
+	__u32 stop;		/* Last rate in Hz */
+	__u32 step;		/* Rate increment in Hz, non-zero */
+	__u32 dwell_us;		/* Time per rate, non-zero */
+	__u32 reserved;		/* Must be zero */
+};
+
+/* One record per sweep step, read() from the character device */
+struct dummy_clk_sweep_sample {
+	__u64 timestamp_ns;	/* CLOCK_MONOTONIC time of the rate change */
+	__u64 achieved;		/* Rate reported afterwards, in Hz */
+	__u32 id;
+	__u32 requested;	/* Rate in Hz */
+	__s32 error;		/* Negative errno when the step failed */
+	__u32 reserved;
+};
+
+#define DUMMY_CLK_IOC_MAGIC	0xdc
+
+#define DUMMY_CLK_IOC_APPLY \
+	_IOW(DUMMY_CLK_IOC_MAGIC, 0, struct dummy_clk_transaction)
+#define DUMMY_CLK_IOC_LOOKUP \
+	_IOWR(DUMMY_CLK_IOC_MAGIC, 1, struct dummy_clk_lookup)
+#define DUMMY_CLK_IOC_SWEEP_START \
+	_IOW(DUMMY_CLK_IOC_MAGIC, 2, struct dummy_clk_sweep_config)
+#define DUMMY_CLK_IOC_SWEEP_STOP \
+	_IOW(DUMMY_CLK_IOC_MAGIC, 3, __u32)
+
+#endif /* _UAPI_DUMMY_CLK_H */